@@ -0,0 +1,69 @@
+/*
+ * bench-plugin.c
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Account plugin for the accounts of bench-telepathy, it never opens a
+ * dialog */
+
+#include "config.h"
+
+#include "rtcom-account-plugin.h"
+
+typedef struct _BenchPluginClass BenchPluginClass;
+typedef struct _BenchPlugin BenchPlugin;
+
+struct _BenchPluginClass
+{
+  RtcomAccountPluginClass parent_class;
+};
+
+struct _BenchPlugin
+{
+  RtcomAccountPlugin parent_instance;
+};
+
+ACCOUNT_DEFINE_PLUGIN(BenchPlugin, bench_plugin, RTCOM_TYPE_ACCOUNT_PLUGIN);
+
+static void
+bench_plugin_init(BenchPlugin *self)
+{
+  RtcomAccountPlugin *plugin = RTCOM_ACCOUNT_PLUGIN(self);
+
+  plugin->name = "bench";
+  plugin->capabilities = RTCOM_PLUGIN_CAPABILITY_ALLOW_MULTIPLE |
+    RTCOM_PLUGIN_CAPABILITY_PASSWORD;
+
+  rtcom_account_plugin_add_service(plugin, "bench/bench");
+}
+
+static void
+bench_plugin_context_init(RtcomAccountPlugin *plugin,
+                          RtcomDialogContext *context)
+{
+}
+
+static void
+bench_plugin_class_init(BenchPluginClass *klass)
+{
+  RTCOM_ACCOUNT_PLUGIN_CLASS(klass)->context_init = bench_plugin_context_init;
+}
+
+static void
+bench_plugin_class_finalize(BenchPluginClass *klass)
+{
+}
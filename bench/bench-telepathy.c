@@ -0,0 +1,659 @@
+/*
+ * bench-telepathy.c
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Fake account manager with a given number of accounts and the "bench"
+ * connection manager they belong to, to be run on a private session bus.
+ * Prints "ready" once both own their names. Accounts never connect. */
+
+#include "config.h"
+
+#include <telepathy-glib/telepathy-glib.h>
+#include <telepathy-glib/telepathy-glib-dbus.h>
+
+#include <stdio.h>
+
+#define BENCH_CM_NAME "bench"
+#define BENCH_PROTOCOL_NAME "bench"
+
+typedef struct _BenchAccountManagerClass BenchAccountManagerClass;
+typedef struct _BenchAccountManager BenchAccountManager;
+
+struct _BenchAccountManagerClass
+{
+  GObjectClass parent_class;
+  TpDBusPropertiesMixinClass dbus_props_class;
+};
+
+struct _BenchAccountManager
+{
+  GObject parent;
+  GPtrArray *paths;
+};
+
+typedef struct _BenchAccountClass BenchAccountClass;
+typedef struct _BenchAccount BenchAccount;
+
+struct _BenchAccountClass
+{
+  GObjectClass parent_class;
+  TpDBusPropertiesMixinClass dbus_props_class;
+};
+
+struct _BenchAccount
+{
+  GObject parent;
+  gchar *name;
+};
+
+typedef struct _BenchProtocolClass BenchProtocolClass;
+typedef struct _BenchProtocol BenchProtocol;
+
+struct _BenchProtocolClass
+{
+  TpBaseProtocolClass parent_class;
+};
+
+struct _BenchProtocol
+{
+  TpBaseProtocol parent;
+};
+
+typedef struct _BenchConnectionManagerClass BenchConnectionManagerClass;
+typedef struct _BenchConnectionManager BenchConnectionManager;
+
+struct _BenchConnectionManagerClass
+{
+  TpBaseConnectionManagerClass parent_class;
+};
+
+struct _BenchConnectionManager
+{
+  TpBaseConnectionManager parent;
+};
+
+G_DEFINE_TYPE_WITH_CODE(
+  BenchAccountManager,
+  bench_account_manager,
+  G_TYPE_OBJECT,
+  G_IMPLEMENT_INTERFACE(TP_TYPE_SVC_ACCOUNT_MANAGER, NULL);
+  G_IMPLEMENT_INTERFACE(TP_TYPE_SVC_DBUS_PROPERTIES,
+                        tp_dbus_properties_mixin_iface_init);
+)
+
+G_DEFINE_TYPE_WITH_CODE(
+  BenchAccount,
+  bench_account,
+  G_TYPE_OBJECT,
+  G_IMPLEMENT_INTERFACE(TP_TYPE_SVC_ACCOUNT, NULL);
+  G_IMPLEMENT_INTERFACE(TP_TYPE_SVC_ACCOUNT_INTERFACE_AVATAR, NULL);
+  G_IMPLEMENT_INTERFACE(TP_TYPE_SVC_ACCOUNT_INTERFACE_ADDRESSING, NULL);
+  G_IMPLEMENT_INTERFACE(TP_TYPE_SVC_DBUS_PROPERTIES,
+                        tp_dbus_properties_mixin_iface_init);
+)
+
+G_DEFINE_TYPE(
+  BenchProtocol,
+  bench_protocol,
+  TP_TYPE_BASE_PROTOCOL
+)
+
+G_DEFINE_TYPE(
+  BenchConnectionManager,
+  bench_connection_manager,
+  TP_TYPE_BASE_CONNECTION_MANAGER
+)
+
+enum
+{
+  AM_PROP_INTERFACES,
+  AM_PROP_VALID_ACCOUNTS,
+  AM_PROP_INVALID_ACCOUNTS,
+  AM_PROP_SUPPORTED_ACCOUNT_PROPERTIES
+};
+
+enum
+{
+  ACCOUNT_PROP_INTERFACES,
+  ACCOUNT_PROP_DISPLAY_NAME,
+  ACCOUNT_PROP_ICON,
+  ACCOUNT_PROP_VALID,
+  ACCOUNT_PROP_ENABLED,
+  ACCOUNT_PROP_NICKNAME,
+  ACCOUNT_PROP_SERVICE,
+  ACCOUNT_PROP_PARAMETERS,
+  ACCOUNT_PROP_AUTOMATIC_PRESENCE,
+  ACCOUNT_PROP_CONNECT_AUTOMATICALLY,
+  ACCOUNT_PROP_CONNECTION,
+  ACCOUNT_PROP_CONNECTION_STATUS,
+  ACCOUNT_PROP_CONNECTION_STATUS_REASON,
+  ACCOUNT_PROP_CONNECTION_ERROR,
+  ACCOUNT_PROP_CONNECTION_ERROR_DETAILS,
+  ACCOUNT_PROP_CURRENT_PRESENCE,
+  ACCOUNT_PROP_REQUESTED_PRESENCE,
+  ACCOUNT_PROP_CHANGING_PRESENCE,
+  ACCOUNT_PROP_NORMALIZED_NAME,
+  ACCOUNT_PROP_HAS_BEEN_ONLINE,
+  ACCOUNT_PROP_SUPERSEDES,
+  ACCOUNT_PROP_AVATAR,
+  ACCOUNT_PROP_URI_SCHEMES
+};
+
+static const gchar *no_strings[] = { NULL };
+
+static const gchar *account_interfaces[] =
+{
+  TP_IFACE_ACCOUNT_INTERFACE_AVATAR,
+  TP_IFACE_ACCOUNT_INTERFACE_ADDRESSING,
+  NULL
+};
+
+static const TpCMParamSpec bench_protocol_params[] =
+{
+  {
+    "account", "s", G_TYPE_STRING, TP_CONN_MGR_PARAM_FLAG_REQUIRED,
+    NULL, 0, NULL, NULL, NULL
+  },
+  {
+    "password", "s", G_TYPE_STRING, TP_CONN_MGR_PARAM_FLAG_SECRET,
+    NULL, 0, NULL, NULL, NULL
+  },
+  { NULL }
+};
+
+static gint accounts = 100;
+
+static GOptionEntry entries[] =
+{
+  {
+    "accounts", 'n', 0, G_OPTION_ARG_INT, &accounts,
+    "Number of accounts to create", "N"
+  },
+  { NULL }
+};
+
+static void
+bench_account_manager_get_dbus_property(GObject *object, GQuark iface,
+                                        GQuark name, GValue *value,
+                                        gpointer getter_data)
+{
+  BenchAccountManager *am = (BenchAccountManager *)object;
+
+  switch (GPOINTER_TO_INT(getter_data))
+  {
+    case AM_PROP_INTERFACES:
+    case AM_PROP_SUPPORTED_ACCOUNT_PROPERTIES:
+    {
+      g_value_set_boxed(value, no_strings);
+      break;
+    }
+    case AM_PROP_VALID_ACCOUNTS:
+    {
+      g_value_set_boxed(value, am->paths);
+      break;
+    }
+    case AM_PROP_INVALID_ACCOUNTS:
+    {
+      g_value_take_boxed(value, g_ptr_array_new());
+      break;
+    }
+    default:
+    {
+      g_assert_not_reached();
+    }
+  }
+}
+
+static void
+bench_account_manager_finalize(GObject *object)
+{
+  BenchAccountManager *am = (BenchAccountManager *)object;
+
+  g_ptr_array_free(am->paths, TRUE);
+
+  G_OBJECT_CLASS(bench_account_manager_parent_class)->finalize(object);
+}
+
+static void
+bench_account_manager_class_init(BenchAccountManagerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  static TpDBusPropertiesMixinPropImpl am_props[] =
+  {
+    { "Interfaces", GINT_TO_POINTER(AM_PROP_INTERFACES), NULL },
+    { "ValidAccounts", GINT_TO_POINTER(AM_PROP_VALID_ACCOUNTS), NULL },
+    { "InvalidAccounts", GINT_TO_POINTER(AM_PROP_INVALID_ACCOUNTS), NULL },
+    {
+      "SupportedAccountProperties",
+      GINT_TO_POINTER(AM_PROP_SUPPORTED_ACCOUNT_PROPERTIES), NULL
+    },
+    { NULL }
+  };
+  static TpDBusPropertiesMixinIfaceImpl prop_interfaces[] =
+  {
+    {
+      TP_IFACE_ACCOUNT_MANAGER, bench_account_manager_get_dbus_property, NULL,
+      am_props
+    },
+    { NULL }
+  };
+
+  object_class->finalize = bench_account_manager_finalize;
+
+  klass->dbus_props_class.interfaces = prop_interfaces;
+  tp_dbus_properties_mixin_class_init(
+    object_class, G_STRUCT_OFFSET(BenchAccountManagerClass, dbus_props_class));
+}
+
+static void
+bench_account_manager_init(BenchAccountManager *am)
+{
+  am->paths = g_ptr_array_new_with_free_func(&g_free);
+}
+
+static GValueArray *
+presence_new(TpConnectionPresenceType type, const gchar *status)
+{
+  return tp_value_array_build(3,
+                              G_TYPE_UINT, type,
+                              G_TYPE_STRING, status,
+                              G_TYPE_STRING, "",
+                              G_TYPE_INVALID);
+}
+
+static void
+bench_account_get_dbus_property(GObject *object, GQuark iface, GQuark name,
+                                GValue *value, gpointer getter_data)
+{
+  BenchAccount *account = (BenchAccount *)object;
+
+  switch (GPOINTER_TO_INT(getter_data))
+  {
+    case ACCOUNT_PROP_INTERFACES:
+    {
+      g_value_set_boxed(value, account_interfaces);
+      break;
+    }
+    case ACCOUNT_PROP_SUPERSEDES:
+    {
+      g_value_take_boxed(value, g_ptr_array_new());
+      break;
+    }
+    case ACCOUNT_PROP_URI_SCHEMES:
+    {
+      g_value_set_boxed(value, no_strings);
+      break;
+    }
+    case ACCOUNT_PROP_DISPLAY_NAME:
+    case ACCOUNT_PROP_NICKNAME:
+    case ACCOUNT_PROP_NORMALIZED_NAME:
+    {
+      g_value_set_string(value, account->name);
+      break;
+    }
+    case ACCOUNT_PROP_ICON:
+    {
+      g_value_set_string(value, "im-" BENCH_PROTOCOL_NAME);
+      break;
+    }
+    case ACCOUNT_PROP_SERVICE:
+    case ACCOUNT_PROP_CONNECTION_ERROR:
+    {
+      g_value_set_string(value, "");
+      break;
+    }
+    case ACCOUNT_PROP_VALID:
+    case ACCOUNT_PROP_ENABLED:
+    case ACCOUNT_PROP_HAS_BEEN_ONLINE:
+    {
+      g_value_set_boolean(value, TRUE);
+      break;
+    }
+    case ACCOUNT_PROP_CONNECT_AUTOMATICALLY:
+    case ACCOUNT_PROP_CHANGING_PRESENCE:
+    {
+      g_value_set_boolean(value, FALSE);
+      break;
+    }
+    case ACCOUNT_PROP_PARAMETERS:
+    {
+      g_value_take_boxed(value,
+                         tp_asv_new("account", G_TYPE_STRING, account->name,
+                                    NULL));
+      break;
+    }
+    case ACCOUNT_PROP_CONNECTION_ERROR_DETAILS:
+    {
+      g_value_take_boxed(value, tp_asv_new(NULL, NULL));
+      break;
+    }
+    case ACCOUNT_PROP_AUTOMATIC_PRESENCE:
+    {
+      g_value_take_boxed(
+        value, presence_new(TP_CONNECTION_PRESENCE_TYPE_AVAILABLE,
+                            "available"));
+      break;
+    }
+    case ACCOUNT_PROP_CURRENT_PRESENCE:
+    case ACCOUNT_PROP_REQUESTED_PRESENCE:
+    {
+      g_value_take_boxed(
+        value, presence_new(TP_CONNECTION_PRESENCE_TYPE_OFFLINE, "offline"));
+      break;
+    }
+    case ACCOUNT_PROP_CONNECTION:
+    {
+      g_value_set_boxed(value, "/");
+      break;
+    }
+    case ACCOUNT_PROP_CONNECTION_STATUS:
+    {
+      g_value_set_uint(value, TP_CONNECTION_STATUS_DISCONNECTED);
+      break;
+    }
+    case ACCOUNT_PROP_CONNECTION_STATUS_REASON:
+    {
+      g_value_set_uint(value, TP_CONNECTION_STATUS_REASON_NONE_SPECIFIED);
+      break;
+    }
+    case ACCOUNT_PROP_AVATAR:
+    {
+      GArray *avatar = g_array_new(FALSE, FALSE, sizeof(guchar));
+
+      g_value_take_boxed(value,
+                         tp_value_array_build(2,
+                                              DBUS_TYPE_G_UCHAR_ARRAY, avatar,
+                                              G_TYPE_STRING, "",
+                                              G_TYPE_INVALID));
+      g_array_unref(avatar);
+      break;
+    }
+    default:
+    {
+      g_assert_not_reached();
+    }
+  }
+}
+
+static void
+bench_account_finalize(GObject *object)
+{
+  g_free(((BenchAccount *)object)->name);
+
+  G_OBJECT_CLASS(bench_account_parent_class)->finalize(object);
+}
+
+static void
+bench_account_class_init(BenchAccountClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  static TpDBusPropertiesMixinPropImpl account_props[] =
+  {
+    { "Interfaces", GINT_TO_POINTER(ACCOUNT_PROP_INTERFACES), NULL },
+    { "DisplayName", GINT_TO_POINTER(ACCOUNT_PROP_DISPLAY_NAME), NULL },
+    { "Icon", GINT_TO_POINTER(ACCOUNT_PROP_ICON), NULL },
+    { "Valid", GINT_TO_POINTER(ACCOUNT_PROP_VALID), NULL },
+    { "Enabled", GINT_TO_POINTER(ACCOUNT_PROP_ENABLED), NULL },
+    { "Nickname", GINT_TO_POINTER(ACCOUNT_PROP_NICKNAME), NULL },
+    { "Service", GINT_TO_POINTER(ACCOUNT_PROP_SERVICE), NULL },
+    { "Parameters", GINT_TO_POINTER(ACCOUNT_PROP_PARAMETERS), NULL },
+    {
+      "AutomaticPresence", GINT_TO_POINTER(ACCOUNT_PROP_AUTOMATIC_PRESENCE),
+      NULL
+    },
+    {
+      "ConnectAutomatically",
+      GINT_TO_POINTER(ACCOUNT_PROP_CONNECT_AUTOMATICALLY), NULL
+    },
+    { "Connection", GINT_TO_POINTER(ACCOUNT_PROP_CONNECTION), NULL },
+    {
+      "ConnectionStatus", GINT_TO_POINTER(ACCOUNT_PROP_CONNECTION_STATUS),
+      NULL
+    },
+    {
+      "ConnectionStatusReason",
+      GINT_TO_POINTER(ACCOUNT_PROP_CONNECTION_STATUS_REASON), NULL
+    },
+    {
+      "ConnectionError", GINT_TO_POINTER(ACCOUNT_PROP_CONNECTION_ERROR), NULL
+    },
+    {
+      "ConnectionErrorDetails",
+      GINT_TO_POINTER(ACCOUNT_PROP_CONNECTION_ERROR_DETAILS), NULL
+    },
+    {
+      "CurrentPresence", GINT_TO_POINTER(ACCOUNT_PROP_CURRENT_PRESENCE), NULL
+    },
+    {
+      "RequestedPresence", GINT_TO_POINTER(ACCOUNT_PROP_REQUESTED_PRESENCE),
+      NULL
+    },
+    {
+      "ChangingPresence", GINT_TO_POINTER(ACCOUNT_PROP_CHANGING_PRESENCE),
+      NULL
+    },
+    {
+      "NormalizedName", GINT_TO_POINTER(ACCOUNT_PROP_NORMALIZED_NAME), NULL
+    },
+    { "HasBeenOnline", GINT_TO_POINTER(ACCOUNT_PROP_HAS_BEEN_ONLINE), NULL },
+    { "Supersedes", GINT_TO_POINTER(ACCOUNT_PROP_SUPERSEDES), NULL },
+    { NULL }
+  };
+  static TpDBusPropertiesMixinPropImpl avatar_props[] =
+  {
+    { "Avatar", GINT_TO_POINTER(ACCOUNT_PROP_AVATAR), NULL },
+    { NULL }
+  };
+  static TpDBusPropertiesMixinPropImpl addressing_props[] =
+  {
+    { "URISchemes", GINT_TO_POINTER(ACCOUNT_PROP_URI_SCHEMES), NULL },
+    { NULL }
+  };
+  static TpDBusPropertiesMixinIfaceImpl prop_interfaces[] =
+  {
+    {
+      TP_IFACE_ACCOUNT, bench_account_get_dbus_property, NULL, account_props
+    },
+    {
+      TP_IFACE_ACCOUNT_INTERFACE_AVATAR, bench_account_get_dbus_property, NULL,
+      avatar_props
+    },
+    {
+      TP_IFACE_ACCOUNT_INTERFACE_ADDRESSING, bench_account_get_dbus_property,
+      NULL, addressing_props
+    },
+    { NULL }
+  };
+
+  object_class->finalize = bench_account_finalize;
+
+  klass->dbus_props_class.interfaces = prop_interfaces;
+  tp_dbus_properties_mixin_class_init(
+    object_class, G_STRUCT_OFFSET(BenchAccountClass, dbus_props_class));
+}
+
+static void
+bench_account_init(BenchAccount *account)
+{
+}
+
+static const TpCMParamSpec *
+bench_protocol_get_parameters(TpBaseProtocol *protocol)
+{
+  return bench_protocol_params;
+}
+
+static TpBaseConnection *
+bench_protocol_new_connection(TpBaseProtocol *protocol, GHashTable *asv,
+                              GError **error)
+{
+  g_set_error(error, TP_ERROR, TP_ERROR_NOT_IMPLEMENTED,
+              "Benchmark accounts never connect");
+
+  return NULL;
+}
+
+static void
+bench_protocol_get_connection_details(TpBaseProtocol *protocol,
+                                      GStrv *connection_interfaces,
+                                      GType **channel_managers,
+                                      gchar **icon_name,
+                                      gchar **english_name,
+                                      gchar **vcard_field)
+{
+  if (connection_interfaces)
+    *connection_interfaces = g_new0(gchar *, 1);
+
+  if (channel_managers)
+    *channel_managers = g_new0(GType, 1);
+
+  if (icon_name)
+    *icon_name = g_strdup("im-" BENCH_PROTOCOL_NAME);
+
+  if (english_name)
+    *english_name = g_strdup("Benchmark");
+
+  if (vcard_field)
+    *vcard_field = g_strdup("x-" BENCH_PROTOCOL_NAME);
+}
+
+static void
+bench_protocol_class_init(BenchProtocolClass *klass)
+{
+  TpBaseProtocolClass *protocol_class = TP_BASE_PROTOCOL_CLASS(klass);
+
+  protocol_class->get_parameters = bench_protocol_get_parameters;
+  protocol_class->new_connection = bench_protocol_new_connection;
+  protocol_class->get_connection_details =
+    bench_protocol_get_connection_details;
+}
+
+static void
+bench_protocol_init(BenchProtocol *protocol)
+{
+}
+
+static void
+bench_connection_manager_constructed(GObject *object)
+{
+  TpBaseProtocol *protocol;
+
+  G_OBJECT_CLASS(bench_connection_manager_parent_class)->constructed(object);
+
+  protocol = g_object_new(bench_protocol_get_type(),
+                          "name", BENCH_PROTOCOL_NAME,
+                          NULL);
+  tp_base_connection_manager_add_protocol(TP_BASE_CONNECTION_MANAGER(object),
+                                          protocol);
+  g_object_unref(protocol);
+}
+
+static void
+bench_connection_manager_class_init(BenchConnectionManagerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  TpBaseConnectionManagerClass *cm_class =
+    TP_BASE_CONNECTION_MANAGER_CLASS(klass);
+
+  object_class->constructed = bench_connection_manager_constructed;
+
+  cm_class->cm_dbus_name = BENCH_CM_NAME;
+}
+
+static void
+bench_connection_manager_init(BenchConnectionManager *cm)
+{
+}
+
+int
+main(int argc, char **argv)
+{
+  GOptionContext *context = g_option_context_new(NULL);
+  TpBaseConnectionManager *cm;
+  BenchAccountManager *am;
+  TpDBusDaemon *dbus;
+  GPtrArray *objects;
+  GMainLoop *loop;
+  GError *error = NULL;
+  gint i;
+
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if (!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    g_printerr("%s\n", error->message);
+    return 1;
+  }
+
+  g_option_context_free(context);
+
+  if (!(dbus = tp_dbus_daemon_dup(&error)))
+  {
+    g_printerr("Unable to connect to the session bus: %s\n", error->message);
+    return 1;
+  }
+
+  cm = g_object_new(bench_connection_manager_get_type(), NULL);
+
+  if (!tp_base_connection_manager_register(cm))
+  {
+    g_printerr("Unable to register the %s connection manager\n",
+               BENCH_CM_NAME);
+    return 1;
+  }
+
+  am = g_object_new(bench_account_manager_get_type(), NULL);
+  objects = g_ptr_array_new_with_free_func(&g_object_unref);
+
+  for (i = 0; i < accounts; i++)
+  {
+    BenchAccount *account = g_object_new(bench_account_get_type(), NULL);
+    gchar *path = g_strdup_printf(
+        "%s%s/%s/account%d", TP_ACCOUNT_OBJECT_PATH_BASE, BENCH_CM_NAME,
+        BENCH_PROTOCOL_NAME, i);
+
+    account->name = g_strdup_printf("bench%04d@example.com", i);
+    tp_dbus_daemon_register_object(dbus, path, account);
+    g_ptr_array_add(am->paths, path);
+    g_ptr_array_add(objects, account);
+  }
+
+  tp_dbus_daemon_register_object(dbus, TP_ACCOUNT_MANAGER_OBJECT_PATH, am);
+
+  if (!tp_dbus_daemon_request_name(dbus, TP_ACCOUNT_MANAGER_BUS_NAME, FALSE,
+                                   &error))
+  {
+    g_printerr("Unable to own %s: %s\n", TP_ACCOUNT_MANAGER_BUS_NAME,
+               error->message);
+    return 1;
+  }
+
+  printf("ready\n");
+  fflush(stdout);
+
+  loop = g_main_loop_new(NULL, FALSE);
+  g_main_loop_run(loop);
+
+  g_main_loop_unref(loop);
+  g_ptr_array_free(objects, TRUE);
+  g_object_unref(am);
+  g_object_unref(cm);
+  g_object_unref(dbus);
+
+  return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * rtcom-accounts-bench.c
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Brings the accounts list up the way the accounts dialog does, in an
+ * offscreen window, and prints how long each stage took in milliseconds:
+ *
+ *   first-expose     first paint of a non-empty list, the snapshot of the
+ *                    last run if there is one
+ *   initialized      all plugins are initialized
+ *   accounts-expose  first paint of the live list
+ *
+ * The snapshot is saved on exit, so a second run with the same
+ * XDG_CACHE_HOME is a warm start. */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "accounts-ui-model.h"
+
+typedef struct
+{
+  AccountsUIModel *model;
+  GtkWidget *tree_view;
+  gint64 start;
+  gint64 first_expose;
+  gint64 initialized;
+  gint64 accounts_expose;
+  gboolean snapshot;
+} BenchRun;
+
+static gint timeout = 300;
+
+static GOptionEntry entries[] =
+{
+  {
+    "timeout", 't', 0, G_OPTION_ARG_INT, &timeout,
+    "Give up after that many seconds", "S"
+  },
+  { NULL }
+};
+
+static gdouble
+elapsed_ms(BenchRun *run, gint64 end)
+{
+  return end ? (end - run->start) / 1000.0 : -1.0;
+}
+
+static gboolean
+tree_view_expose_event_cb(GtkWidget *tree_view, GdkEventExpose *event,
+                          BenchRun *run)
+{
+  GtkTreeModel *model = gtk_tree_view_get_model(GTK_TREE_VIEW(tree_view));
+  gint64 now = g_get_monotonic_time();
+
+  if (!model || !gtk_tree_model_iter_n_children(model, NULL))
+    return FALSE;
+
+  if (!run->first_expose)
+    run->first_expose = now;
+
+  if (model == accounts_ui_model_get_store(run->model))
+  {
+    run->accounts_expose = now;
+    gtk_main_quit();
+  }
+
+  return FALSE;
+}
+
+static void
+model_initialized_cb(AccountsUIModel *model, GParamSpec *pspec, BenchRun *run)
+{
+  run->initialized = g_get_monotonic_time();
+  gtk_tree_view_set_model(GTK_TREE_VIEW(run->tree_view),
+                          accounts_ui_model_get_store(model));
+}
+
+static gboolean
+timeout_cb(gpointer user_data)
+{
+  g_printerr("Timed out, are bench-telepathy and the bench plugin there?\n");
+  gtk_main_quit();
+
+  return G_SOURCE_REMOVE;
+}
+
+static GtkWidget *
+create_tree_view(void)
+{
+  GtkWidget *tree_view = gtk_tree_view_new();
+  GtkCellRenderer *renderer;
+
+  renderer = gtk_cell_renderer_pixbuf_new();
+  gtk_tree_view_insert_column_with_attributes(
+    GTK_TREE_VIEW(tree_view), -1, NULL, renderer,
+    "pixbuf", ACCOUNTS_UI_COLUMN_SERVICE_ICON, NULL);
+
+  renderer = gtk_cell_renderer_text_new();
+  gtk_tree_view_insert_column_with_attributes(
+    GTK_TREE_VIEW(tree_view), -1, NULL, renderer,
+    "markup", ACCOUNTS_UI_COLUMN_USER_NAME_MARKUP, NULL);
+
+  renderer = gtk_cell_renderer_text_new();
+  gtk_tree_view_insert_column_with_attributes(
+    GTK_TREE_VIEW(tree_view), -1, NULL, renderer,
+    "markup", ACCOUNTS_UI_COLUMN_STATUS_MARKUP, NULL);
+
+  renderer = gtk_cell_renderer_pixbuf_new();
+  gtk_tree_view_insert_column_with_attributes(
+    GTK_TREE_VIEW(tree_view), -1, NULL, renderer,
+    "pixbuf", ACCOUNTS_UI_COLUMN_AVATAR, NULL);
+
+  return tree_view;
+}
+
+int
+main(int argc, char **argv)
+{
+  GOptionContext *context = g_option_context_new(NULL);
+  BenchRun run = { 0 };
+  GtkWidget *window;
+  GtkTreeModel *model;
+  GError *error = NULL;
+  gint rows;
+
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gtk_get_option_group(TRUE));
+
+  if (!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    g_printerr("%s\n", error->message);
+    return 1;
+  }
+
+  g_option_context_free(context);
+
+  window = gtk_offscreen_window_new();
+  gtk_window_set_default_size(GTK_WINDOW(window), 800, 480);
+  run.tree_view = create_tree_view();
+  g_signal_connect_after(run.tree_view, "expose-event",
+                         G_CALLBACK(tree_view_expose_event_cb), &run);
+  gtk_container_add(GTK_CONTAINER(window), run.tree_view);
+
+  run.start = g_get_monotonic_time();
+  run.model = accounts_ui_model_dup_default();
+
+  if (accounts_ui_model_is_initialized(run.model))
+    model_initialized_cb(run.model, NULL, &run);
+  else
+  {
+    GtkTreeModel *snapshot = accounts_ui_model_get_snapshot(run.model);
+
+    if (snapshot)
+    {
+      run.snapshot = TRUE;
+      gtk_tree_view_set_model(GTK_TREE_VIEW(run.tree_view), snapshot);
+    }
+
+    g_signal_connect(run.model, "notify::initialized",
+                     G_CALLBACK(model_initialized_cb), &run);
+  }
+
+  gtk_widget_show_all(window);
+  g_timeout_add_seconds(timeout, timeout_cb, NULL);
+  gtk_main();
+
+  model = accounts_ui_model_get_store(run.model);
+  rows = gtk_tree_model_iter_n_children(model, NULL);
+
+  printf("%s rows=%d first-expose=%.1f initialized=%.1f "
+         "accounts-expose=%.1f\n", run.snapshot ? "warm" : "cold", rows,
+         elapsed_ms(&run, run.first_expose), elapsed_ms(&run, run.initialized),
+         elapsed_ms(&run, run.accounts_expose));
+
+  gtk_widget_destroy(window);
+  g_signal_handlers_disconnect_matched(
+    run.model, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+    model_initialized_cb, &run);
+
+  /* writes the snapshot for the next run */
+  g_object_unref(run.model);
+
+  return run.accounts_expose ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# Runs rtcom-accounts-bench against bench-telepathy on a private session
+# bus, once per number of accounts given on the command line. Each number
+# gets a cold run, with an empty cache, and a warm one, with the snapshot
+# and the protocol cache left by the cold run. Run it from the bench build
+# directory, it needs dbus-launch, and xvfb-run if there is no X display.
+
+set -e
+
+if [ -z "$DISPLAY" ] && [ -z "$RUN_BENCH_XVFB" ]; then
+  RUN_BENCH_XVFB=1 exec xvfb-run -a sh "$0" "$@"
+fi
+
+builddir=$(pwd)
+tmpdir=$(mktemp -d)
+telepathy_pid=
+
+cleanup()
+{
+  [ -n "$telepathy_pid" ] && kill "$telepathy_pid" 2>/dev/null
+  [ -n "$DBUS_SESSION_BUS_PID" ] && kill "$DBUS_SESSION_BUS_PID" 2>/dev/null
+  rm -rf "$tmpdir"
+}
+
+trap cleanup EXIT
+
+eval "$(dbus-launch --sh-syntax)"
+
+export RTCOM_ACCOUNTS_PLUGIN_DIR="$builddir/.libs"
+export XDG_CACHE_HOME="$tmpdir/cache"
+
+for accounts in "$@"; do
+  ./bench-telepathy --accounts "$accounts" > "$tmpdir/telepathy.out" &
+  telepathy_pid=$!
+
+  until grep -q ready "$tmpdir/telepathy.out"; do
+    kill -0 "$telepathy_pid"
+    sleep 0.1
+  done
+
+  rm -rf "$XDG_CACHE_HOME"
+
+  for run in cold warm; do
+    printf "%5d accounts: " "$accounts"
+    ./rtcom-accounts-bench
+  done
+
+  kill "$telepathy_pid"
+  wait "$telepathy_pid" || true
+  telepathy_pid=
+done
@@ -0,0 +1,1409 @@
+/*
+ * accounts-ui-model.c
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <hildon/hildon.h>
+
+#include <libintl.h>
+
+#include "accounts-ui-snapshot.h"
+#include "rtcom-trace.h"
+
+#include "accounts-ui-model.h"
+
+struct _AccountsUIModelPrivate
+{
+  GtkListStore *store;
+  AccountPluginManager *account_plugin_manager;
+  GdkPixbuf *avatar_icon;
+  guint plugins_initialized_lock;
+  guint batch_level;
+  gint batch_sort_column_id;
+  GtkSortType batch_sort_order;
+  gboolean initialized : 1;
+  /* key is AccountItem, value is AccountsUIModelRow */
+  GHashTable *item_rows;
+  /* key is "<service name>\n<user name>", value is GList of AccountItems,
+   * several accounts can have the same name. The lists are not owned by the
+   * table, so they can be replaced in place, and are freed on dispose. */
+  GHashTable *name_items;
+  gchar *active_text_color;
+  gchar *secondary_text_color;
+  /* rows of the last run, shown until the plugins are initialized */
+  GtkListStore *snapshot_store;
+  /* start of the "plugins-initialize" trace span */
+  gint64 init_begin;
+  /* AccountItems with dirty rows, flushed together on idle */
+  GHashTable *dirty_items;
+  guint flush_id;
+  /* pending snapshot save, restarted on every change of the list */
+  guint snapshot_id;
+};
+
+typedef struct _AccountsUIModelPrivate AccountsUIModelPrivate;
+
+/* seconds the list must be unchanged before the snapshot is written */
+#define SNAPSHOT_SAVE_DELAY 2
+
+/* columns of a row that are out of date, see flush_row() */
+enum
+{
+  ROW_DIRTY_NAME = 1 << 0,
+  ROW_DIRTY_DISPLAY_NAME = 1 << 1,
+  ROW_DIRTY_ENABLED = 1 << 2,
+  ROW_DIRTY_DRAFT = 1 << 3,
+  ROW_DIRTY_AVATAR = 1 << 4,
+  ROW_DIRTY_MARKUP = 1 << 5
+};
+
+struct _AccountsUIModelRow
+{
+  GtkTreeRowReference *ref;
+  guint dirty;
+  gchar *name_key;
+  /* g_utf8_collate_key() of COLUMN_NAME and COLUMN_SERVICE_NAME */
+  gchar *name_collate_key;
+  gchar *service_name_collate_key;
+};
+
+typedef struct _AccountsUIModelRow AccountsUIModelRow;
+
+#define PRIVATE(model) \
+  ((AccountsUIModelPrivate *) \
+   accounts_ui_model_get_instance_private((AccountsUIModel *)(model)))
+
+static void
+accounts_list_iface_init(AccountsListIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(
+  AccountsUIModel,
+  accounts_ui_model,
+  G_TYPE_OBJECT,
+  G_IMPLEMENT_INTERFACE(
+    ACCOUNTS_TYPE_LIST,
+    accounts_list_iface_init);
+  G_ADD_PRIVATE(AccountsUIModel);
+)
+
+enum
+{
+  PROP_INITIALIZED = 1
+};
+
+enum
+{
+  PLUGIN_INITIALIZED,
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+static AccountsUIModel *default_model = NULL;
+
+static gchar *
+get_name_key(const gchar *service_name, const gchar *user_name)
+{
+  if (!user_name)
+    return NULL;
+
+  return g_strconcat(service_name ? service_name : "", "\n", user_name, NULL);
+}
+
+static gchar *
+get_item_name_key(AccountItem *account_item)
+{
+  AccountService *service = account_item_get_service(account_item);
+  gchar *service_name = NULL;
+  gchar *user_name = NULL;
+  gchar *key;
+
+  g_object_get(account_item, "name", &user_name, NULL);
+
+  if (service)
+    g_object_get(service, "name", &service_name, NULL);
+
+  key = get_name_key(service_name, user_name);
+  g_free(service_name);
+  g_free(user_name);
+
+  return key;
+}
+
+static void
+accounts_ui_model_row_set_name(AccountsUIModelRow *row, const gchar *name)
+{
+  g_free(row->name_collate_key);
+  row->name_collate_key = name ? g_utf8_collate_key(name, -1) : NULL;
+}
+
+static AccountsUIModelRow *
+accounts_ui_model_row_new(const gchar *name, const gchar *service_name)
+{
+  AccountsUIModelRow *row = g_slice_new0(AccountsUIModelRow);
+
+  accounts_ui_model_row_set_name(row, name);
+
+  if (service_name)
+    row->service_name_collate_key = g_utf8_collate_key(service_name, -1);
+
+  return row;
+}
+
+static void
+accounts_ui_model_row_free(AccountsUIModelRow *row)
+{
+  gtk_tree_row_reference_free(row->ref);
+  g_free(row->name_key);
+  g_free(row->name_collate_key);
+  g_free(row->service_name_collate_key);
+  g_slice_free(AccountsUIModelRow, row);
+}
+
+static void
+index_remove_name_key(AccountsUIModelPrivate *priv, AccountItem *account_item,
+                      AccountsUIModelRow *row)
+{
+  GList *items;
+
+  if (!row->name_key)
+    return;
+
+  items = g_hash_table_lookup(priv->name_items, row->name_key);
+  items = g_list_remove(items, account_item);
+
+  if (items)
+    g_hash_table_insert(priv->name_items, g_strdup(row->name_key), items);
+  else
+    g_hash_table_remove(priv->name_items, row->name_key);
+}
+
+static void
+index_set_name_key(AccountsUIModelPrivate *priv, AccountItem *account_item,
+                   AccountsUIModelRow *row)
+{
+  if (row->name_key)
+  {
+    index_remove_name_key(priv, account_item, row);
+    g_free(row->name_key);
+  }
+
+  row->name_key = get_item_name_key(account_item);
+
+  if (row->name_key)
+  {
+    GList *items = g_hash_table_lookup(priv->name_items, row->name_key);
+
+    g_hash_table_insert(priv->name_items, g_strdup(row->name_key),
+                        g_list_append(items, account_item));
+  }
+}
+
+static void
+index_add(AccountsUIModelPrivate *priv, AccountItem *account_item,
+          AccountsUIModelRow *row, GtkTreeIter *iter)
+{
+  GtkTreePath *path = gtk_tree_model_get_path(GTK_TREE_MODEL(priv->store),
+                                              iter);
+
+  row->ref = gtk_tree_row_reference_new(GTK_TREE_MODEL(priv->store), path);
+  gtk_tree_path_free(path);
+
+  index_set_name_key(priv, account_item, row);
+  g_hash_table_insert(priv->item_rows, account_item, row);
+}
+
+static void
+index_remove(AccountsUIModelPrivate *priv, AccountItem *account_item)
+{
+  AccountsUIModelRow *row = g_hash_table_lookup(priv->item_rows, account_item);
+
+  if (!row)
+    return;
+
+  index_remove_name_key(priv, account_item, row);
+  g_hash_table_remove(priv->item_rows, account_item);
+}
+
+static gboolean
+index_get_iter(AccountsUIModelPrivate *priv, AccountItem *account_item,
+               GtkTreeIter *iter)
+{
+  AccountsUIModelRow *row;
+  GtkTreePath *path;
+  gboolean rv;
+
+  if (!priv->item_rows)
+    return FALSE;
+
+  row = g_hash_table_lookup(priv->item_rows, account_item);
+
+  if (!row || !(path = gtk_tree_row_reference_get_path(row->ref)))
+    return FALSE;
+
+  rv = gtk_tree_model_get_iter(GTK_TREE_MODEL(priv->store), iter, path);
+  gtk_tree_path_free(path);
+
+  return rv;
+}
+
+static const char *
+get_text_color(const gchar *id)
+{
+  static char buf[40];
+  GdkColor color;
+  GtkStyle *style = gtk_rc_get_style_by_paths(
+      gtk_settings_get_default(), NULL, NULL, GTK_TYPE_LABEL);
+
+  if (gtk_style_lookup_color(style, id, &color))
+  {
+    sprintf(buf, "#%02x%02x%02x",
+            color.red >> 8, color.green >> 8, color.blue >> 8);
+  }
+
+  return buf;
+}
+
+static gboolean
+update_text_colors(AccountsUIModelPrivate *priv)
+{
+  const char *color;
+  gboolean changed = FALSE;
+
+  /* get_text_color() returns a static buffer, copy before the next call */
+  color = get_text_color("ActiveTextColor");
+
+  if (g_strcmp0(color, priv->active_text_color))
+  {
+    g_free(priv->active_text_color);
+    priv->active_text_color = g_strdup(color);
+    changed = TRUE;
+  }
+
+  color = get_text_color("SecondaryTextColor");
+
+  if (g_strcmp0(color, priv->secondary_text_color))
+  {
+    g_free(priv->secondary_text_color);
+    priv->secondary_text_color = g_strdup(color);
+    changed = TRUE;
+  }
+
+  return changed;
+}
+
+static gchar *
+get_status_markup(AccountsUIModelPrivate *priv, gboolean enabled,
+                  gboolean draft)
+{
+  const char *span;
+
+  if (draft)
+    span = _("accounts_fi_draft");
+  else if (enabled)
+    span = _("accounts_fi_enabled");
+  else
+    span = _("accounts_fi_disabled");
+
+  return g_markup_printf_escaped(
+      "<span size=\"x-small\" foreground=\"%s\">%s</span>",
+      priv->active_text_color, span);
+}
+
+static gchar *
+get_user_name_markup(AccountsUIModelPrivate *priv, const gchar *name,
+                     const gchar *display_name)
+{
+  if (name && *name)
+  {
+    if (display_name && *display_name)
+    {
+      return g_markup_printf_escaped(
+          "%s\n<span size=\"x-small\" foreground=\"%s\">%s</span>", name,
+          priv->secondary_text_color, display_name);
+    }
+    else
+      return g_markup_escape_text(name, -1);
+  }
+
+  return g_strdup("");
+}
+
+static void
+row_set_string(gint *columns, GValue *values, gint *n, gint column,
+               gchar *str)
+{
+  columns[*n] = column;
+  g_value_init(&values[*n], G_TYPE_STRING);
+  g_value_take_string(&values[*n], str);
+  (*n)++;
+}
+
+static void
+row_set_int(gint *columns, GValue *values, gint *n, gint column, gint val)
+{
+  columns[*n] = column;
+  g_value_init(&values[*n], G_TYPE_INT);
+  g_value_set_int(&values[*n], val);
+  (*n)++;
+}
+
+/* Applies all the dirty columns of @account_item's row in a single store
+ * update, so the row is changed (and re-sorted) only once */
+static void
+flush_row(AccountsUIModelPrivate *priv, AccountItem *account_item,
+          AccountsUIModelRow *row)
+{
+  gint columns[ACCOUNTS_UI_COLUMN_STATUS_MARKUP + 1];
+  GValue values[ACCOUNTS_UI_COLUMN_STATUS_MARKUP + 1] = { { 0 } };
+  guint dirty = row->dirty;
+  gchar *display_name = NULL;
+  gchar *name = NULL;
+  gboolean enabled = FALSE;
+  gboolean draft = FALSE;
+  GtkTreeIter iter;
+  gint n = 0;
+  gint i;
+
+  row->dirty = 0;
+
+  if (!index_get_iter(priv, account_item, &iter))
+    return;
+
+  g_object_get(account_item,
+               "name", &name,
+               "display-name", &display_name,
+               "enabled", &enabled,
+               "draft", &draft,
+               NULL);
+
+  if (dirty & ROW_DIRTY_NAME)
+  {
+    /* sort key must be up to date before the store re-sorts the row */
+    accounts_ui_model_row_set_name(row, name);
+    row_set_string(columns, values, &n, ACCOUNTS_UI_COLUMN_NAME,
+                   g_strdup(name));
+  }
+
+  if (dirty & ROW_DIRTY_DISPLAY_NAME)
+  {
+    row_set_string(columns, values, &n, ACCOUNTS_UI_COLUMN_DISPLAY_NAME,
+                   g_strdup(display_name));
+  }
+
+  if (dirty & ROW_DIRTY_ENABLED)
+    row_set_int(columns, values, &n, ACCOUNTS_UI_COLUMN_ENABLED, enabled);
+
+  if (dirty & ROW_DIRTY_DRAFT)
+    row_set_int(columns, values, &n, ACCOUNTS_UI_COLUMN_DRAFT, draft);
+
+  if (dirty & ROW_DIRTY_AVATAR)
+  {
+    GdkPixbuf *avatar = NULL;
+    gboolean supports_avatar = FALSE;
+
+    g_object_get(account_item,
+                 "avatar", &avatar,
+                 "supports-avatar", &supports_avatar,
+                 NULL);
+
+    if (!avatar && supports_avatar && priv->avatar_icon)
+      avatar = g_object_ref(priv->avatar_icon);
+
+    columns[n] = ACCOUNTS_UI_COLUMN_AVATAR;
+    g_value_init(&values[n], GDK_TYPE_PIXBUF);
+    g_value_take_object(&values[n], avatar);
+    n++;
+  }
+
+  if (dirty & ROW_DIRTY_MARKUP)
+  {
+    row_set_string(columns, values, &n, ACCOUNTS_UI_COLUMN_USER_NAME_MARKUP,
+                   get_user_name_markup(priv, name, display_name));
+    row_set_string(columns, values, &n, ACCOUNTS_UI_COLUMN_STATUS_MARKUP,
+                   get_status_markup(priv, enabled, draft));
+  }
+
+  gtk_list_store_set_valuesv(priv->store, &iter, columns, values, n);
+
+  for (i = 0; i < n; i++)
+    g_value_unset(&values[i]);
+
+  g_free(name);
+  g_free(display_name);
+}
+
+static void queue_snapshot_save(AccountsUIModel *model);
+
+static gboolean
+flush_dirty_rows_idle(gpointer user_data)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(user_data);
+  GHashTableIter iter;
+  gpointer item;
+
+  priv->flush_id = 0;
+
+  g_hash_table_iter_init(&iter, priv->dirty_items);
+
+  while (g_hash_table_iter_next(&iter, &item, NULL))
+  {
+    AccountsUIModelRow *row = g_hash_table_lookup(priv->item_rows, item);
+
+    g_hash_table_iter_remove(&iter);
+
+    if (row)
+      flush_row(priv, item, row);
+  }
+
+  queue_snapshot_save(user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+mark_row_dirty(AccountsUIModel *model, AccountItem *account_item,
+               guint dirty)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(model);
+  AccountsUIModelRow *row;
+
+  if (!priv->item_rows ||
+      !(row = g_hash_table_lookup(priv->item_rows, account_item)))
+  {
+    return;
+  }
+
+  row->dirty |= dirty;
+  g_hash_table_insert(priv->dirty_items, account_item, NULL);
+
+  if (!priv->flush_id)
+  {
+    priv->flush_id = g_idle_add_full(G_PRIORITY_HIGH_IDLE,
+                                     flush_dirty_rows_idle, model, NULL);
+  }
+}
+
+static void
+item_notify_cb(AccountItem *account_item, GParamSpec *pspec,
+               AccountsUIModel *model)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(model);
+  guint dirty = 0;
+
+  if (!strcmp(pspec->name, "name"))
+  {
+    AccountsUIModelRow *row = NULL;
+
+    if (priv->item_rows)
+      row = g_hash_table_lookup(priv->item_rows, account_item);
+
+    /* lookups by name must find the account right away */
+    if (row)
+      index_set_name_key(priv, account_item, row);
+
+    dirty = ROW_DIRTY_NAME | ROW_DIRTY_MARKUP;
+  }
+  else if (!strcmp(pspec->name, "display-name"))
+    dirty = ROW_DIRTY_DISPLAY_NAME | ROW_DIRTY_MARKUP;
+  else if (!strcmp(pspec->name, "enabled"))
+    dirty = ROW_DIRTY_ENABLED | ROW_DIRTY_MARKUP;
+  else if (!strcmp(pspec->name, "draft"))
+    dirty = ROW_DIRTY_DRAFT | ROW_DIRTY_MARKUP;
+  else if (!strcmp(pspec->name, "avatar"))
+    dirty = ROW_DIRTY_AVATAR;
+
+  if (dirty)
+    mark_row_dirty(model, account_item, dirty);
+}
+
+static gboolean
+_disconnect_all_items(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter,
+                      gpointer data)
+{
+  gpointer item;
+
+  gtk_tree_model_get(model, iter, ACCOUNTS_UI_COLUMN_ACCOUNT_ITEM, &item, -1);
+
+  if (item)
+  {
+    g_signal_handlers_disconnect_matched(
+      item, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+      item_notify_cb, data);
+    g_object_unref(item);
+  }
+
+  return FALSE;
+}
+
+static gboolean
+foreach_func(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter,
+             gpointer data)
+{
+  gpointer item;
+  GList **l = data;
+
+  gtk_tree_model_get(model, iter, ACCOUNTS_UI_COLUMN_ACCOUNT_ITEM, &item, -1);
+
+  if (item)
+  {
+    g_object_unref(item);
+    *l = g_list_prepend(*l, item);
+  }
+
+  return FALSE;
+}
+
+static GList *
+_accounts_list_get_all(AccountsList *accounts_list)
+{
+  AccountsUIModelPrivate *priv;
+  GList *l = NULL;
+
+  g_return_val_if_fail(ACCOUNTS_IS_UI_MODEL(accounts_list), NULL);
+
+  priv = PRIVATE(accounts_list);
+
+  if (priv->store)
+    gtk_tree_model_foreach(GTK_TREE_MODEL(priv->store), foreach_func, &l);
+
+  return l;
+}
+
+/* While a batch is active the store is unsorted, so adding rows does not
+ * re-sort the list. Views attach to the store once the model is
+ * initialized, so they are not updated for every row either. */
+static void
+accounts_list_begin_batch(AccountsUIModel *model)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(model);
+
+  if (priv->batch_level++)
+    return;
+
+  if (!gtk_tree_sortable_get_sort_column_id(
+        GTK_TREE_SORTABLE(priv->store), &priv->batch_sort_column_id,
+        &priv->batch_sort_order))
+  {
+    priv->batch_sort_column_id = GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID;
+  }
+
+  gtk_tree_sortable_set_sort_column_id(
+    GTK_TREE_SORTABLE(priv->store), GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
+    GTK_SORT_ASCENDING);
+}
+
+static void
+accounts_list_end_batch(AccountsUIModel *model)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(model);
+
+  g_return_if_fail(priv->batch_level > 0);
+
+  if (--priv->batch_level)
+    return;
+
+  if (!priv->store)
+    return;
+
+  gtk_tree_sortable_set_sort_column_id(
+    GTK_TREE_SORTABLE(priv->store), priv->batch_sort_column_id,
+    priv->batch_sort_order);
+}
+
+static void
+_accounts_list_remove(AccountsList *accounts_list, AccountItem *account_item)
+{
+  AccountsUIModelPrivate *priv;
+  GtkTreeIter iter;
+
+  g_return_if_fail(ACCOUNTS_IS_UI_MODEL(accounts_list));
+  g_return_if_fail(ACCOUNT_IS_ITEM(account_item));
+
+  priv = PRIVATE(accounts_list);
+
+  if (index_get_iter(priv, account_item, &iter))
+  {
+    g_signal_handlers_disconnect_matched(
+      account_item, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+      item_notify_cb, accounts_list);
+    g_hash_table_remove(priv->dirty_items, account_item);
+    /* ROW_DATA must stay valid while the row is being deleted */
+    gtk_list_store_remove(priv->store, &iter);
+    index_remove(priv, account_item);
+    queue_snapshot_save(ACCOUNTS_UI_MODEL(accounts_list));
+  }
+}
+
+static void
+_accounts_list_add(AccountsList *accounts_list, AccountItem *account_item)
+{
+  AccountsUIModelPrivate *priv;
+  gpointer service_icon = NULL;
+  gpointer avatar = NULL;
+  gpointer service_name = NULL;
+  gpointer display_name = NULL;
+  gpointer name = NULL;
+  gboolean draft = FALSE;
+  gboolean enabled = FALSE;
+  gboolean supports_avatar = FALSE;
+  gchar *user_name_markup;
+  gchar *status_markup;
+  AccountsUIModelRow *row;
+  GtkTreeIter iter;
+
+  g_return_if_fail(ACCOUNTS_IS_UI_MODEL(accounts_list));
+  g_return_if_fail(ACCOUNT_IS_ITEM(account_item));
+
+  priv = PRIVATE(accounts_list);
+
+  if (g_hash_table_lookup(priv->item_rows, account_item))
+  {
+    g_warning("%s: account item %p already in the list", __FUNCTION__,
+              account_item);
+    return;
+  }
+
+  g_object_get(account_item,
+               "name", &name,
+               "avatar", &avatar,
+               "enabled", &enabled,
+               "draft", &draft,
+               "display-name", &display_name,
+               "service-name", &service_name,
+               "service-icon", &service_icon,
+               "supports-avatar", &supports_avatar,
+               NULL);
+  g_signal_connect(account_item, "notify::name",
+                   G_CALLBACK(item_notify_cb), accounts_list);
+  g_signal_connect(account_item, "notify::avatar",
+                   G_CALLBACK(item_notify_cb), accounts_list);
+  g_signal_connect(account_item, "notify::enabled",
+                   G_CALLBACK(item_notify_cb), accounts_list);
+  g_signal_connect(account_item, "notify::draft",
+                   G_CALLBACK(item_notify_cb), accounts_list);
+  g_signal_connect(account_item, "notify::display-name",
+                   G_CALLBACK(item_notify_cb), accounts_list);
+
+  if (!avatar && supports_avatar && priv->avatar_icon)
+    avatar = g_object_ref(priv->avatar_icon);
+
+  row = accounts_ui_model_row_new(name, service_name);
+  user_name_markup = get_user_name_markup(priv, name, display_name);
+  status_markup = get_status_markup(priv, enabled, draft);
+  gtk_list_store_insert_with_values(
+    priv->store, &iter, 0,
+    ACCOUNTS_UI_COLUMN_AVATAR, avatar,
+    ACCOUNTS_UI_COLUMN_NAME, name,
+    ACCOUNTS_UI_COLUMN_DISPLAY_NAME, display_name,
+    ACCOUNTS_UI_COLUMN_SERVICE_NAME, service_name,
+    ACCOUNTS_UI_COLUMN_SERVICE_ICON, service_icon,
+    ACCOUNTS_UI_COLUMN_ENABLED, enabled,
+    ACCOUNTS_UI_COLUMN_DRAFT, draft,
+    ACCOUNTS_UI_COLUMN_ACCOUNT_ITEM, account_item,
+    ACCOUNTS_UI_COLUMN_ROW_DATA, row,
+    ACCOUNTS_UI_COLUMN_USER_NAME_MARKUP, user_name_markup,
+    ACCOUNTS_UI_COLUMN_STATUS_MARKUP, status_markup,
+    -1);
+  index_add(priv, account_item, row, &iter);
+  g_free(user_name_markup);
+  g_free(status_markup);
+  g_free(name);
+  g_free(display_name);
+  g_free(service_name);
+
+  if (avatar)
+    g_object_unref(avatar);
+
+  if (service_icon)
+    g_object_unref(service_icon);
+
+  queue_snapshot_save(ACCOUNTS_UI_MODEL(accounts_list));
+}
+
+static void
+accounts_list_iface_init(AccountsListIface *iface)
+{
+  iface->add = _accounts_list_add;
+  iface->get_all = _accounts_list_get_all;
+  iface->remove = _accounts_list_remove;
+}
+
+static GtkListStore *
+accounts_ui_store_new(void)
+{
+  return gtk_list_store_new(11, GDK_TYPE_PIXBUF, G_TYPE_STRING,
+                            G_TYPE_STRING, G_TYPE_STRING,
+                            GDK_TYPE_PIXBUF, G_TYPE_INT, G_TYPE_INT,
+                            ACCOUNT_TYPE_ITEM, G_TYPE_POINTER,
+                            G_TYPE_STRING, G_TYPE_STRING);
+}
+
+static gint
+compare_snapshot_rows(gconstpointer a, gconstpointer b)
+{
+  const AccountsUISnapshotRow *rowa = a;
+  const AccountsUISnapshotRow *rowb = b;
+
+  if (rowa->name && rowb->name)
+    return g_utf8_collate(rowa->name, rowb->name);
+
+  return (rowa->name != NULL) - (rowb->name != NULL);
+}
+
+static void
+load_snapshot(AccountsUIModel *model)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(model);
+  GList *rows = accounts_ui_snapshot_load();
+  GList *l;
+
+  if (!rows)
+    return;
+
+  rows = g_list_sort(rows, compare_snapshot_rows);
+  priv->snapshot_store = accounts_ui_store_new();
+
+  for (l = rows; l; l = l->next)
+  {
+    AccountsUISnapshotRow *row = l->data;
+    GdkPixbuf *avatar = row->avatar;
+    gchar *user_name_markup;
+    gchar *status_markup;
+
+    if (!avatar && row->default_avatar)
+      avatar = priv->avatar_icon;
+
+    user_name_markup = get_user_name_markup(priv, row->name,
+                                            row->display_name);
+    status_markup = get_status_markup(priv, row->enabled, row->draft);
+    gtk_list_store_insert_with_values(
+      priv->snapshot_store, NULL, -1,
+      ACCOUNTS_UI_COLUMN_AVATAR, avatar,
+      ACCOUNTS_UI_COLUMN_NAME, row->name,
+      ACCOUNTS_UI_COLUMN_DISPLAY_NAME, row->display_name,
+      ACCOUNTS_UI_COLUMN_SERVICE_NAME, row->service_name,
+      ACCOUNTS_UI_COLUMN_SERVICE_ICON, row->service_icon,
+      ACCOUNTS_UI_COLUMN_ENABLED, row->enabled,
+      ACCOUNTS_UI_COLUMN_DRAFT, row->draft,
+      ACCOUNTS_UI_COLUMN_USER_NAME_MARKUP, user_name_markup,
+      ACCOUNTS_UI_COLUMN_STATUS_MARKUP, status_markup,
+      -1);
+    g_free(user_name_markup);
+    g_free(status_markup);
+  }
+
+  g_list_free_full(rows, (GDestroyNotify)&accounts_ui_snapshot_row_free);
+}
+
+static void
+drop_snapshot(AccountsUIModel *model)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(model);
+
+  if (priv->snapshot_store)
+    g_clear_object(&priv->snapshot_store);
+}
+
+static void
+save_snapshot(AccountsUIModel *model)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(model);
+  GtkTreeModel *store = GTK_TREE_MODEL(priv->store);
+  GList *rows = NULL;
+  GtkTreeIter iter;
+
+  if (gtk_tree_model_get_iter_first(store, &iter))
+  {
+    do
+    {
+      AccountsUISnapshotRow *row = accounts_ui_snapshot_row_new();
+
+      gtk_tree_model_get(store, &iter,
+                         ACCOUNTS_UI_COLUMN_AVATAR, &row->avatar,
+                         ACCOUNTS_UI_COLUMN_NAME, &row->name,
+                         ACCOUNTS_UI_COLUMN_DISPLAY_NAME, &row->display_name,
+                         ACCOUNTS_UI_COLUMN_SERVICE_NAME, &row->service_name,
+                         ACCOUNTS_UI_COLUMN_SERVICE_ICON, &row->service_icon,
+                         ACCOUNTS_UI_COLUMN_ENABLED, &row->enabled,
+                         ACCOUNTS_UI_COLUMN_DRAFT, &row->draft,
+                         -1);
+
+      if (row->avatar && row->avatar == priv->avatar_icon)
+      {
+        g_clear_object(&row->avatar);
+        row->default_avatar = TRUE;
+      }
+
+      rows = g_list_prepend(rows, row);
+    }
+    while (gtk_tree_model_iter_next(store, &iter));
+  }
+
+  accounts_ui_snapshot_save(g_list_reverse(rows));
+  g_list_free_full(rows, (GDestroyNotify)&accounts_ui_snapshot_row_free);
+}
+
+static gboolean
+save_snapshot_timeout(gpointer user_data)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(user_data);
+
+  priv->snapshot_id = 0;
+
+  if (priv->store)
+    save_snapshot(ACCOUNTS_UI_MODEL(user_data));
+
+  return G_SOURCE_REMOVE;
+}
+
+/* the snapshot is kept up to date while the process runs, so it is current
+ * even if the process is killed or stays in standby for long */
+static void
+queue_snapshot_save(AccountsUIModel *model)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(model);
+
+  /* rows added while the plugins initialize are saved once they are done */
+  if (!priv->initialized)
+    return;
+
+  if (priv->snapshot_id)
+    g_source_remove(priv->snapshot_id);
+
+  priv->snapshot_id = g_timeout_add_seconds_full(
+      G_PRIORITY_LOW, SNAPSHOT_SAVE_DELAY, save_snapshot_timeout, model,
+      NULL);
+}
+
+static void
+plugin_initialization_done(AccountsUIModel *model)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(model);
+
+  g_return_if_fail(priv->plugins_initialized_lock > 0);
+
+  priv->plugins_initialized_lock--;
+
+  if (!priv->plugins_initialized_lock)
+  {
+    accounts_list_end_batch(model);
+    drop_snapshot(model);
+    rtcom_trace_end(priv->init_begin, "plugins-initialize", NULL);
+    priv->initialized = TRUE;
+    g_object_notify(G_OBJECT(model), "initialized");
+    queue_snapshot_save(model);
+  }
+}
+
+static void
+on_plugin_initialized(AccountPlugin *plugin, GParamSpec *pspec,
+                      AccountsUIModel *model)
+{
+  gboolean initialized = FALSE;
+
+  g_object_get(plugin, "initialized", &initialized, NULL);
+
+  if (initialized)
+  {
+    g_signal_handlers_disconnect_matched(
+      plugin, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC,
+      0, 0, NULL, on_plugin_initialized, model);
+    rtcom_trace_mark("plugin-initialized", account_plugin_get_name(plugin));
+    g_signal_emit(model, signals[PLUGIN_INITIALIZED], 0, plugin);
+    plugin_initialization_done(model);
+  }
+}
+
+static gboolean
+idle_plugin_initialization_done(gpointer user_data)
+{
+  AccountsUIModel *model = user_data;
+
+  /* we must do the last call in idle, otherwise the views will not have a
+   * chance to connect to notify::initialized if there are no plugins or all
+   * plugins are immediately initialized */
+  plugin_initialization_done(model);
+  g_object_unref(model);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+init_plugins(AccountsUIModel *model)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(model);
+  const gchar *plugin_dir = g_getenv("RTCOM_ACCOUNTS_PLUGIN_DIR");
+  GList *plugin_paths;
+  GList *plugins;
+  gint64 begin;
+
+  /* the benchmark loads its own plugin from the build tree */
+  if (!plugin_dir || !*plugin_dir)
+    plugin_dir = PLUGINLIBDIR;
+
+  plugin_paths = g_list_prepend(NULL, (gpointer)plugin_dir);
+
+  priv->init_begin = rtcom_trace_begin();
+
+  /* accounts of all plugins are added in a single batch, ended in
+   * plugin_initialization_done() once the last plugin is initialized */
+  accounts_list_begin_batch(model);
+
+  begin = rtcom_trace_begin();
+  load_snapshot(model);
+  rtcom_trace_end(begin, "snapshot-load", NULL);
+
+  /* libaccounts loads every plugin of the directory here, before any of
+   * them says which services it provides. Only the wait is per plugin, see
+   * accounts_ui_model_is_service_ready() */
+  begin = rtcom_trace_begin();
+  priv->account_plugin_manager =
+    account_plugin_manager_new(plugin_paths, ACCOUNTS_LIST(model));
+  g_list_free(plugin_paths);
+  rtcom_trace_end(begin, "plugins-load", plugin_dir);
+
+  plugins = account_plugin_manager_list(priv->account_plugin_manager);
+
+  priv->plugins_initialized_lock = 1;
+
+  if (plugins)
+  {
+    GList *l;
+
+    for (l = plugins; l; l = l->next)
+    {
+      gboolean initialized = FALSE;
+
+      priv->plugins_initialized_lock++;
+
+      g_object_get(l->data, "initialized", &initialized, NULL);
+
+      if (!initialized)
+      {
+        g_signal_connect(l->data, "notify::initialized",
+                         G_CALLBACK(on_plugin_initialized), model);
+      }
+      else
+        plugin_initialization_done(model);
+    }
+
+    g_list_free(plugins);
+  }
+
+  g_idle_add_full(G_PRIORITY_HIGH_IDLE, idle_plugin_initialization_done,
+                  g_object_ref(model), NULL);
+}
+
+static gint
+sort_func(GtkTreeModel *model, GtkTreeIter *a, GtkTreeIter *b,
+          gpointer user_data)
+{
+  gint rv;
+
+  if (GPOINTER_TO_INT(user_data) == ACCOUNTS_UI_COLUMN_ENABLED)
+  {
+    gboolean ena = FALSE;
+    gboolean enb = FALSE;
+
+    gtk_tree_model_get(model, a, ACCOUNTS_UI_COLUMN_ENABLED, &ena, -1);
+    gtk_tree_model_get(model, b, ACCOUNTS_UI_COLUMN_ENABLED, &enb, -1);
+
+    rv = enb - ena;
+  }
+  else
+  {
+    AccountsUIModelRow *rowa = NULL;
+    AccountsUIModelRow *rowb = NULL;
+    const gchar *vala = NULL;
+    const gchar *valb = NULL;
+
+    gtk_tree_model_get(model, a, ACCOUNTS_UI_COLUMN_ROW_DATA, &rowa, -1);
+    gtk_tree_model_get(model, b, ACCOUNTS_UI_COLUMN_ROW_DATA, &rowb, -1);
+
+    if (GPOINTER_TO_INT(user_data) == ACCOUNTS_UI_COLUMN_SERVICE_NAME)
+    {
+      vala = rowa ? rowa->service_name_collate_key : NULL;
+      valb = rowb ? rowb->service_name_collate_key : NULL;
+    }
+    else
+    {
+      vala = rowa ? rowa->name_collate_key : NULL;
+      valb = rowb ? rowb->name_collate_key : NULL;
+    }
+
+    if (vala)
+    {
+      if (valb)
+        rv = strcmp(vala, valb);
+      else
+        rv = 1;
+    }
+    else
+      rv = -(valb != 0);
+  }
+
+  return rv;
+}
+
+static void
+accounts_ui_model_dispose(GObject *object)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(object);
+
+  /* only changes that were not written yet */
+  if (priv->snapshot_id)
+  {
+    g_source_remove(priv->snapshot_id);
+    priv->snapshot_id = 0;
+
+    if (priv->store)
+      save_snapshot(ACCOUNTS_UI_MODEL(object));
+  }
+
+  if (priv->snapshot_store)
+    g_clear_object(&priv->snapshot_store);
+
+  if (priv->account_plugin_manager)
+    g_clear_object(&priv->account_plugin_manager);
+
+  if (priv->flush_id)
+  {
+    g_source_remove(priv->flush_id);
+    priv->flush_id = 0;
+  }
+
+  if (priv->dirty_items)
+  {
+    g_hash_table_destroy(priv->dirty_items);
+    priv->dirty_items = NULL;
+  }
+
+  /* rows go first, ROW_DATA points to the AccountsUIModelRows freed below */
+  if (priv->store)
+  {
+    gtk_tree_model_foreach(GTK_TREE_MODEL(priv->store),
+                           _disconnect_all_items, object);
+    gtk_list_store_clear(priv->store);
+    g_clear_object(&priv->store);
+  }
+
+  if (priv->name_items)
+  {
+    GHashTableIter iter;
+    gpointer items;
+
+    g_hash_table_iter_init(&iter, priv->name_items);
+
+    while (g_hash_table_iter_next(&iter, NULL, &items))
+      g_list_free(items);
+
+    g_hash_table_destroy(priv->name_items);
+    priv->name_items = NULL;
+  }
+
+  if (priv->item_rows)
+  {
+    g_hash_table_destroy(priv->item_rows);
+    priv->item_rows = NULL;
+  }
+
+  if (priv->avatar_icon)
+    g_clear_object(&priv->avatar_icon);
+
+  G_OBJECT_CLASS(accounts_ui_model_parent_class)->dispose(object);
+}
+
+static void
+accounts_ui_model_finalize(GObject *object)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(object);
+
+  g_free(priv->active_text_color);
+  g_free(priv->secondary_text_color);
+
+  G_OBJECT_CLASS(accounts_ui_model_parent_class)->finalize(object);
+}
+
+static void
+accounts_ui_model_get_property(GObject *object, guint property_id,
+                               GValue *value, GParamSpec *pspec)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(object);
+
+  switch (property_id)
+  {
+    case PROP_INITIALIZED:
+    {
+      g_value_set_boolean(value, priv->initialized);
+      break;
+    }
+    default:
+    {
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+      break;
+    }
+  }
+}
+
+static void
+accounts_ui_model_class_init(AccountsUIModelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+  object_class->dispose = accounts_ui_model_dispose;
+  object_class->finalize = accounts_ui_model_finalize;
+  object_class->get_property = accounts_ui_model_get_property;
+
+  g_object_class_install_property(
+    object_class, PROP_INITIALIZED,
+    g_param_spec_boolean(
+      "initialized",
+      "initialized",
+      "Whether all the plugins have been initialized",
+      FALSE,
+      G_PARAM_READABLE));
+
+  signals[PLUGIN_INITIALIZED] = g_signal_new(
+      "plugin-initialized", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST,
+      0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT,
+      G_TYPE_NONE, 1, ACCOUNT_TYPE_PLUGIN);
+}
+
+static void
+accounts_ui_model_init(AccountsUIModel *model)
+{
+  AccountsUIModelPrivate *priv = PRIVATE(model);
+
+  update_text_colors(priv);
+  priv->store = accounts_ui_store_new();
+  priv->item_rows = g_hash_table_new_full(
+      (GHashFunc)&g_direct_hash,
+      (GEqualFunc)&g_direct_equal,
+      NULL,
+      (GDestroyNotify)&accounts_ui_model_row_free);
+  priv->name_items = g_hash_table_new_full(
+      (GHashFunc)&g_str_hash,
+      (GEqualFunc)&g_str_equal,
+      (GDestroyNotify)&g_free,
+      NULL);
+  priv->dirty_items = g_hash_table_new((GHashFunc)&g_direct_hash,
+                                       (GEqualFunc)&g_direct_equal);
+
+  gtk_tree_sortable_set_sort_func(
+    GTK_TREE_SORTABLE(priv->store), ACCOUNTS_UI_COLUMN_NAME,
+    sort_func, GINT_TO_POINTER(ACCOUNTS_UI_COLUMN_NAME), NULL);
+  gtk_tree_sortable_set_sort_func(
+    GTK_TREE_SORTABLE(priv->store), ACCOUNTS_UI_COLUMN_SERVICE_NAME,
+    sort_func, GINT_TO_POINTER(ACCOUNTS_UI_COLUMN_SERVICE_NAME), NULL);
+  gtk_tree_sortable_set_sort_func(
+    GTK_TREE_SORTABLE(priv->store), ACCOUNTS_UI_COLUMN_ENABLED,
+    sort_func, GINT_TO_POINTER(ACCOUNTS_UI_COLUMN_ENABLED), NULL);
+
+  gtk_tree_sortable_set_sort_column_id(
+    GTK_TREE_SORTABLE(priv->store), ACCOUNTS_UI_COLUMN_NAME,
+    GTK_SORT_ASCENDING);
+
+  priv->avatar_icon = gtk_icon_theme_load_icon(
+      gtk_icon_theme_get_default(),
+      "general_default_avatar", HILDON_ICON_PIXEL_SIZE_FINGER, 0, NULL);
+
+  init_plugins(model);
+}
+
+AccountsUIModel *
+accounts_ui_model_dup_default(void)
+{
+  if (default_model)
+    return g_object_ref(default_model);
+
+  default_model = g_object_new(ACCOUNTS_TYPE_UI_MODEL, NULL);
+  g_object_add_weak_pointer(G_OBJECT(default_model),
+                            (gpointer *)&default_model);
+
+  return default_model;
+}
+
+gboolean
+accounts_ui_model_is_initialized(AccountsUIModel *model)
+{
+  g_return_val_if_fail(ACCOUNTS_IS_UI_MODEL(model), FALSE);
+
+  return PRIVATE(model)->initialized;
+}
+
+GtkTreeModel *
+accounts_ui_model_get_store(AccountsUIModel *model)
+{
+  g_return_val_if_fail(ACCOUNTS_IS_UI_MODEL(model), NULL);
+
+  return GTK_TREE_MODEL(PRIVATE(model)->store);
+}
+
+GtkTreeModel *
+accounts_ui_model_get_snapshot(AccountsUIModel *model)
+{
+  g_return_val_if_fail(ACCOUNTS_IS_UI_MODEL(model), NULL);
+
+  return (GtkTreeModel *)PRIVATE(model)->snapshot_store;
+}
+
+AccountPluginManager *
+accounts_ui_model_get_plugin_manager(AccountsUIModel *model)
+{
+  g_return_val_if_fail(ACCOUNTS_IS_UI_MODEL(model), NULL);
+
+  return PRIVATE(model)->account_plugin_manager;
+}
+
+gboolean
+accounts_ui_model_has_plugins(AccountsUIModel *model)
+{
+  GList *plugins;
+
+  g_return_val_if_fail(ACCOUNTS_IS_UI_MODEL(model), FALSE);
+
+  plugins = account_plugin_manager_list(PRIVATE(model)->account_plugin_manager);
+  g_list_free(plugins);
+
+  return plugins != NULL;
+}
+
+AccountItem *
+accounts_ui_model_find_account(AccountsUIModel *model,
+                               const gchar *service_name,
+                               const gchar *user_name)
+{
+  AccountsUIModelPrivate *priv;
+  AccountItem *account = NULL;
+  GList *l = NULL;
+  gchar *key;
+
+  g_return_val_if_fail(ACCOUNTS_IS_UI_MODEL(model), NULL);
+
+  priv = PRIVATE(model);
+  key = get_name_key(service_name, user_name);
+
+  if (key)
+    l = g_hash_table_lookup(priv->name_items, key);
+
+  g_free(key);
+
+  for (; l && !account; l = l->next)
+  {
+    GtkTreeIter iter;
+
+    if (index_get_iter(priv, l->data, &iter))
+      account = l->data;
+  }
+
+  return account;
+}
+
+static AccountService *
+find_service(AccountsUIModel *model, const gchar *service_name,
+             AccountPlugin **plugin)
+{
+  AccountService *service = NULL;
+  GList *plugins;
+  GList *p;
+
+  plugins = account_plugin_manager_list(PRIVATE(model)->account_plugin_manager);
+
+  for (p = plugins; p && !service; p = p->next)
+  {
+    if (p->data)
+    {
+      GList *services = account_plugin_list_services(p->data);
+      GList *s;
+
+      for (s = services; s; s = s->next)
+      {
+        if (s->data)
+        {
+          if (!g_strcmp0(account_service_get_name(s->data), service_name))
+          {
+            service = s->data;
+
+            if (plugin)
+              *plugin = p->data;
+
+            break;
+          }
+        }
+      }
+
+      g_list_free(services);
+    }
+  }
+
+  g_list_free(plugins);
+
+  return service;
+}
+
+AccountService *
+accounts_ui_model_find_service(AccountsUIModel *model,
+                               const gchar *service_name)
+{
+  g_return_val_if_fail(ACCOUNTS_IS_UI_MODEL(model), NULL);
+
+  return find_service(model, service_name, NULL);
+}
+
+gboolean
+accounts_ui_model_is_service_ready(AccountsUIModel *model,
+                                   const gchar *service_name)
+{
+  AccountPlugin *plugin = NULL;
+  gboolean initialized = FALSE;
+
+  g_return_val_if_fail(ACCOUNTS_IS_UI_MODEL(model), FALSE);
+
+  if (PRIVATE(model)->initialized)
+    return TRUE;
+
+  /* services are registered when the plugins are loaded, so the plugin
+   * providing @service_name is known long before it is initialized */
+  if (service_name && find_service(model, service_name, &plugin))
+    g_object_get(plugin, "initialized", &initialized, NULL);
+
+  return initialized;
+}
+
+void
+accounts_ui_model_update_style(AccountsUIModel *model)
+{
+  AccountsUIModelPrivate *priv;
+
+  g_return_if_fail(ACCOUNTS_IS_UI_MODEL(model));
+
+  priv = PRIVATE(model);
+
+  if (update_text_colors(priv) && priv->item_rows)
+  {
+    GHashTableIter iter;
+    gpointer item;
+
+    g_hash_table_iter_init(&iter, priv->item_rows);
+
+    while (g_hash_table_iter_next(&iter, &item, NULL))
+      mark_row_dirty(model, item, ROW_DIRTY_MARKUP);
+  }
+}
@@ -0,0 +1,128 @@
+/*
+ * accounts-ui-model.h
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ACCOUNTSUIMODEL_H
+#define ACCOUNTSUIMODEL_H
+
+#include <gtk/gtk.h>
+#include <libaccounts/account-plugin-manager.h>
+
+G_BEGIN_DECLS
+
+#define ACCOUNTS_TYPE_UI_MODEL \
+                (accounts_ui_model_get_type ())
+#define ACCOUNTS_UI_MODEL(obj) \
+                (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+                 ACCOUNTS_TYPE_UI_MODEL, \
+                 AccountsUIModel))
+#define ACCOUNTS_UI_MODEL_CLASS(klass) \
+                (G_TYPE_CHECK_CLASS_CAST ((klass), \
+                 ACCOUNTS_TYPE_UI_MODEL, \
+                 AccountsUIModelClass))
+#define ACCOUNTS_IS_UI_MODEL(obj) \
+                (G_TYPE_CHECK_INSTANCE_TYPE ((obj), \
+                 ACCOUNTS_TYPE_UI_MODEL))
+#define ACCOUNTS_IS_UI_MODEL_CLASS(klass) \
+                (G_TYPE_CHECK_CLASS_TYPE ((klass), \
+                 ACCOUNTS_TYPE_UI_MODEL))
+#define ACCOUNTS_UI_MODEL_GET_CLASS(obj) \
+                (G_TYPE_INSTANCE_GET_CLASS ((obj), \
+                 ACCOUNTS_TYPE_UI_MODEL, \
+                 AccountsUIModelClass))
+
+typedef struct _AccountsUIModelClass AccountsUIModelClass;
+typedef struct _AccountsUIModel AccountsUIModel;
+
+struct _AccountsUIModelClass
+{
+  GObjectClass parent_class;
+};
+
+/* The accounts list and the plugins feeding it, shared by all the accounts
+ * dialogs of the process */
+struct _AccountsUIModel
+{
+  GObject parent;
+};
+
+enum
+{
+  ACCOUNTS_UI_COLUMN_AVATAR,
+  ACCOUNTS_UI_COLUMN_NAME,
+  ACCOUNTS_UI_COLUMN_DISPLAY_NAME,
+  ACCOUNTS_UI_COLUMN_SERVICE_NAME,
+  ACCOUNTS_UI_COLUMN_SERVICE_ICON,
+  ACCOUNTS_UI_COLUMN_ENABLED,
+  ACCOUNTS_UI_COLUMN_DRAFT,
+  ACCOUNTS_UI_COLUMN_ACCOUNT_ITEM,
+  ACCOUNTS_UI_COLUMN_ROW_DATA,
+  ACCOUNTS_UI_COLUMN_USER_NAME_MARKUP,
+  ACCOUNTS_UI_COLUMN_STATUS_MARKUP
+};
+
+GType
+accounts_ui_model_get_type(void) G_GNUC_CONST;
+
+/* Returns a new reference to the model of the process, creating it and
+ * starting plugins initialization if there is none */
+AccountsUIModel *
+accounts_ui_model_dup_default(void);
+
+gboolean
+accounts_ui_model_is_initialized(AccountsUIModel *model);
+
+/* The live accounts list, complete once the model is initialized */
+GtkTreeModel *
+accounts_ui_model_get_store(AccountsUIModel *model);
+
+/* Accounts list of the last run, NULL if there is none or once the model
+ * is initialized */
+GtkTreeModel *
+accounts_ui_model_get_snapshot(AccountsUIModel *model);
+
+AccountPluginManager *
+accounts_ui_model_get_plugin_manager(AccountsUIModel *model);
+
+gboolean
+accounts_ui_model_has_plugins(AccountsUIModel *model);
+
+AccountItem *
+accounts_ui_model_find_account(AccountsUIModel *model,
+                               const gchar *service_name,
+                               const gchar *user_name);
+
+AccountService *
+accounts_ui_model_find_service(AccountsUIModel *model,
+                               const gchar *service_name);
+
+/* Whether the plugin providing @service_name has been initialized, so its
+ * accounts are in the list. Services of unknown plugins are ready once the
+ * whole model is. "plugin-initialized" is emitted whenever this might have
+ * changed. */
+gboolean
+accounts_ui_model_is_service_ready(AccountsUIModel *model,
+                                   const gchar *service_name);
+
+/* Regenerates the list markup if the theme colors changed */
+void
+accounts_ui_model_update_style(AccountsUIModel *model);
+
+G_END_DECLS
+
+#endif /* ACCOUNTSUIMODEL_H */
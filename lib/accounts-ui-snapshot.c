@@ -0,0 +1,273 @@
+/*
+ * accounts-ui-snapshot.c
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+
+#include <errno.h>
+
+#include "accounts-ui-snapshot.h"
+
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_GROUP "snapshot"
+/* avatars are stored as thumbnails no bigger than this */
+#define SNAPSHOT_ICON_SIZE 48
+
+static gchar *
+get_snapshot_path(void)
+{
+  return g_build_filename(g_get_user_cache_dir(), "rtcom-accounts-ui",
+                          "accounts-list", NULL);
+}
+
+AccountsUISnapshotRow *
+accounts_ui_snapshot_row_new(void)
+{
+  return g_slice_new0(AccountsUISnapshotRow);
+}
+
+void
+accounts_ui_snapshot_row_free(AccountsUISnapshotRow *row)
+{
+  if (!row)
+    return;
+
+  g_free(row->name);
+  g_free(row->display_name);
+  g_free(row->service_name);
+
+  if (row->avatar)
+    g_object_unref(row->avatar);
+
+  if (row->service_icon)
+    g_object_unref(row->service_icon);
+
+  g_slice_free(AccountsUISnapshotRow, row);
+}
+
+static GdkPixbuf *
+pixbuf_from_base64(const gchar *data)
+{
+  GdkPixbufLoader *loader;
+  GdkPixbuf *pixbuf = NULL;
+  guchar *buf;
+  gsize len;
+
+  if (!data || !*data)
+    return NULL;
+
+  buf = g_base64_decode(data, &len);
+  loader = gdk_pixbuf_loader_new_with_type("png", NULL);
+
+  if (loader)
+  {
+    if (gdk_pixbuf_loader_write(loader, buf, len, NULL) &&
+        gdk_pixbuf_loader_close(loader, NULL))
+    {
+      pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+
+      if (pixbuf)
+        g_object_ref(pixbuf);
+    }
+    else
+      gdk_pixbuf_loader_close(loader, NULL);
+
+    g_object_unref(loader);
+  }
+
+  g_free(buf);
+
+  return pixbuf;
+}
+
+/* the encoded thumbnail is kept on the pixbuf, so saving the snapshot again
+ * only encodes avatars and icons that changed since the last save */
+static const gchar *
+pixbuf_to_base64(GdkPixbuf *pixbuf)
+{
+  static GQuark base64_quark = 0;
+  GdkPixbuf *thumbnail;
+  gchar *buf = NULL;
+  gsize len = 0;
+  gchar *rv;
+  gint w = gdk_pixbuf_get_width(pixbuf);
+  gint h = gdk_pixbuf_get_height(pixbuf);
+
+  if (!base64_quark)
+    base64_quark = g_quark_from_static_string("accounts-ui-snapshot-base64");
+
+  if ((rv = g_object_get_qdata(G_OBJECT(pixbuf), base64_quark)))
+    return rv;
+
+  if (w > SNAPSHOT_ICON_SIZE || h > SNAPSHOT_ICON_SIZE)
+  {
+    /* keep the aspect ratio, so the row looks the same in the live list */
+    if (w > h)
+    {
+      h = MAX(1, h * SNAPSHOT_ICON_SIZE / w);
+      w = SNAPSHOT_ICON_SIZE;
+    }
+    else
+    {
+      w = MAX(1, w * SNAPSHOT_ICON_SIZE / h);
+      h = SNAPSHOT_ICON_SIZE;
+    }
+
+    thumbnail = gdk_pixbuf_scale_simple(pixbuf, w, h, GDK_INTERP_BILINEAR);
+  }
+  else
+    thumbnail = g_object_ref(pixbuf);
+
+  if (gdk_pixbuf_save_to_buffer(thumbnail, &buf, &len, "png", NULL, NULL))
+  {
+    rv = g_base64_encode((guchar *)buf, len);
+    g_object_set_qdata_full(G_OBJECT(pixbuf), base64_quark, rv,
+                            (GDestroyNotify)&g_free);
+  }
+
+  g_free(buf);
+  g_object_unref(thumbnail);
+
+  return rv;
+}
+
+GList *
+accounts_ui_snapshot_load(void)
+{
+  GKeyFile *key_file = g_key_file_new();
+  gchar *path = get_snapshot_path();
+  GList *rows = NULL;
+  gchar **groups;
+  gchar **group;
+
+  if (!g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, NULL) ||
+      (g_key_file_get_integer(key_file, SNAPSHOT_GROUP, "version", NULL) !=
+       SNAPSHOT_VERSION))
+  {
+    goto out;
+  }
+
+  groups = g_key_file_get_groups(key_file, NULL);
+
+  for (group = groups; *group; group++)
+  {
+    AccountsUISnapshotRow *row;
+    gchar *data;
+
+    if (!g_str_has_prefix(*group, "row "))
+      continue;
+
+    row = accounts_ui_snapshot_row_new();
+    row->name = g_key_file_get_string(key_file, *group, "name", NULL);
+    row->display_name = g_key_file_get_string(key_file, *group,
+                                              "display-name", NULL);
+    row->service_name = g_key_file_get_string(key_file, *group,
+                                              "service-name", NULL);
+    row->enabled = g_key_file_get_boolean(key_file, *group, "enabled", NULL);
+    row->draft = g_key_file_get_boolean(key_file, *group, "draft", NULL);
+    row->default_avatar = g_key_file_get_boolean(key_file, *group,
+                                                 "default-avatar", NULL);
+
+    data = g_key_file_get_string(key_file, *group, "avatar", NULL);
+    row->avatar = pixbuf_from_base64(data);
+    g_free(data);
+
+    data = g_key_file_get_string(key_file, *group, "service-icon", NULL);
+    row->service_icon = pixbuf_from_base64(data);
+    g_free(data);
+
+    rows = g_list_prepend(rows, row);
+  }
+
+  g_strfreev(groups);
+  rows = g_list_reverse(rows);
+
+out:
+  g_key_file_free(key_file);
+  g_free(path);
+
+  return rows;
+}
+
+void
+accounts_ui_snapshot_save(GList *rows)
+{
+  GKeyFile *key_file = g_key_file_new();
+  gchar *path = get_snapshot_path();
+  gchar *dir = g_path_get_dirname(path);
+  GError *error = NULL;
+  const gchar *base64;
+  gchar *data;
+  gsize len;
+  int i = 0;
+
+  g_key_file_set_integer(key_file, SNAPSHOT_GROUP, "version",
+                         SNAPSHOT_VERSION);
+
+  for (; rows; rows = rows->next)
+  {
+    AccountsUISnapshotRow *row = rows->data;
+    gchar *group = g_strdup_printf("row %d", i++);
+
+    if (row->name)
+      g_key_file_set_string(key_file, group, "name", row->name);
+
+    if (row->display_name)
+    {
+      g_key_file_set_string(key_file, group, "display-name",
+                            row->display_name);
+    }
+
+    if (row->service_name)
+    {
+      g_key_file_set_string(key_file, group, "service-name",
+                            row->service_name);
+    }
+
+    g_key_file_set_boolean(key_file, group, "enabled", row->enabled);
+    g_key_file_set_boolean(key_file, group, "draft", row->draft);
+    g_key_file_set_boolean(key_file, group, "default-avatar",
+                           row->default_avatar);
+
+    if (row->avatar && (base64 = pixbuf_to_base64(row->avatar)))
+      g_key_file_set_string(key_file, group, "avatar", base64);
+
+    if (row->service_icon && (base64 = pixbuf_to_base64(row->service_icon)))
+      g_key_file_set_string(key_file, group, "service-icon", base64);
+
+    g_free(group);
+  }
+
+  data = g_key_file_to_data(key_file, &len, NULL);
+
+  /* written to a temporary file and renamed, never left half written */
+  if (g_mkdir_with_parents(dir, 0700) ||
+      !g_file_set_contents(path, data, len, &error))
+  {
+    g_warning("%s: Unable to save accounts list snapshot to %s: %s",
+              __FUNCTION__, path, error ? error->message : g_strerror(errno));
+    g_clear_error(&error);
+  }
+
+  g_free(data);
+  g_free(dir);
+  g_free(path);
+  g_key_file_free(key_file);
+}
@@ -0,0 +1,59 @@
+/*
+ * accounts-ui-snapshot.h
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ACCOUNTSUISNAPSHOT_H
+#define ACCOUNTSUISNAPSHOT_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+/* Last known state of an accounts list row, used to paint the list before
+ * the plugins are initialized */
+struct _AccountsUISnapshotRow
+{
+  gchar *name;
+  gchar *display_name;
+  gchar *service_name;
+  gboolean enabled;
+  gboolean draft;
+  /* NULL with default_avatar set means the theme default avatar */
+  gboolean default_avatar;
+  GdkPixbuf *avatar;
+  GdkPixbuf *service_icon;
+};
+
+typedef struct _AccountsUISnapshotRow AccountsUISnapshotRow;
+
+AccountsUISnapshotRow *
+accounts_ui_snapshot_row_new(void);
+
+void
+accounts_ui_snapshot_row_free(AccountsUISnapshotRow *row);
+
+/* returns a list of AccountsUISnapshotRow, in the order they were saved */
+GList *
+accounts_ui_snapshot_load(void);
+
+void
+accounts_ui_snapshot_save(GList *rows);
+
+G_END_DECLS
+
+#endif /* ACCOUNTSUISNAPSHOT_H */
@@ -27,23 +27,23 @@
 #include <libintl.h>
 #include <sys/vfs.h>
 
+#include "accounts-ui-model.h"
 #include "accounts-wizard-dialog.h"
+#include "rtcom-trace.h"
 
 #include "accounts-ui.h"
 
 struct _AccountsUIPrivate
 {
-  GtkListStore *store;
-  AccountPluginManager *account_plugin_manager;
+  AccountsUIModel *model;
   GtkWidget *pannable_area;
   GtkWidget *tree_view;
   GtkWidget *label;
   GtkWidget *button_new;
-  GdkPixbuf *avatar_icon;
-  guint plugins_initialized_lock;
   gboolean initialized : 1;   /* 0x01 */
   gboolean wizard_active : 1; /* 0x02 */
   gboolean show : 1;          /* 0x04 */
+  gboolean snapshot_exposed : 1;
   GdkWindow *parent_window;
 };
 
@@ -76,175 +76,26 @@ enum
 
 enum
 {
-  COLUMN_AVATAR,
-  COLUMN_NAME,
-  COLUMN_DISPLAY_NAME,
-  COLUMN_SERVICE_NAME,
-  COLUMN_SERVICE_ICON,
-  COLUMN_ENABLED,
-  COLUMN_DRAFT,
-  COLUMN_ACCOUNT_ITEM
+  PLUGIN_INITIALIZED,
+  LAST_SIGNAL
 };
 
-static void
-update_store(GtkTreeModel *model, AccountItem *account_item, int column,
-             gpointer value, GType value_type)
-{
-  GtkTreeIter iter;
-
-  if (!model || !account_item)
-    return;
-
-  if (!gtk_tree_model_get_iter_first(model, &iter))
-    return;
-
-  do
-  {
-    AccountItem *item = NULL;
-    gtk_tree_model_get(model, &iter, COLUMN_ACCOUNT_ITEM, &item, -1);
-
-    if (item)
-      g_object_unref(item);
-
-    if (account_item == item)
-    {
-      switch (value_type)
-      {
-        case G_TYPE_POINTER:
-        /* fall-through */
-        case G_TYPE_STRING:
-        {
-          gtk_list_store_set(GTK_LIST_STORE(model), &iter, column, value, -1);
-          break;
-        }
-        case G_TYPE_BOOLEAN:
-        {
-          gboolean bval = GPOINTER_TO_INT(value);
-
-          gtk_list_store_set(GTK_LIST_STORE(model), &iter, column, bval, -1);
-          break;
-        }
-        default:
-        {
-          g_warn_if_reached();
-          break;
-        }
-      }
-
-      break;
-    }
-  }
-  while (gtk_tree_model_iter_next(model, &iter));
-}
+static guint signals[LAST_SIGNAL] = { 0 };
 
 static void
-name_notify_cb(AccountItem *account_item, GParamSpec *pspec, AccountsUI *ui)
-{
-  AccountsUIPrivate *priv = PRIVATE(ui);
-  gpointer name = NULL;
-
-  g_object_get(account_item, "name", &name, NULL);
-  update_store(GTK_TREE_MODEL(priv->store), account_item,
-               COLUMN_NAME, name, G_TYPE_STRING);
-  g_free(name);
-}
+model_initialized_cb(AccountsUIModel *model, GParamSpec *pspec,
+                     AccountsUI *ui);
 
 static void
-avatar_notify_cb(AccountItem *account_item, GParamSpec *pspec, AccountsUI *ui)
-{
-  AccountsUIPrivate *priv = PRIVATE(ui);
-  gpointer avatar = NULL;
-  gboolean supports_avatar = FALSE;
-
-  g_object_get(account_item,
-               "avatar", &avatar,
-               "supports-avatar", &supports_avatar,
-               NULL);
-
-  if (!avatar)
-  {
-    if (supports_avatar && priv->avatar_icon)
-      avatar = g_object_ref((gpointer)priv->avatar_icon);
-  }
-
-  update_store(GTK_TREE_MODEL(priv->store), account_item,
-               COLUMN_AVATAR, avatar, G_TYPE_POINTER);
-
-  if (avatar)
-    g_object_unref(avatar);
-}
+model_plugin_initialized_cb(AccountsUIModel *model, AccountPlugin *plugin,
+                            AccountsUI *ui);
 
 static void
-draft_notify_cb(AccountItem *account_item, GParamSpec *pspec, AccountsUI *ui)
-{
-  AccountsUIPrivate *priv = PRIVATE(ui);
-  gboolean draft = FALSE;
-
-  g_object_get(account_item, "draft", &draft, NULL);
-  update_store(GTK_TREE_MODEL(priv->store), account_item, COLUMN_DRAFT,
-               GINT_TO_POINTER(draft), G_TYPE_BOOLEAN);
-}
+store_row_inserted_cb(GtkTreeModel *store, GtkTreePath *path,
+                      GtkTreeIter *iter, AccountsUI *ui);
 
 static void
-enabled_notify_cb(AccountItem *account_item, GParamSpec *pspec, AccountsUI *ui)
-{
-  AccountsUIPrivate *priv = PRIVATE(ui);
-  gboolean enabled = FALSE;
-
-  g_object_get(account_item, "enabled", &enabled, NULL);
-  update_store(GTK_TREE_MODEL(priv->store), account_item,
-               COLUMN_ENABLED, GINT_TO_POINTER(enabled), G_TYPE_BOOLEAN);
-}
-
-static void
-display_name_notify_cb(AccountItem *account_item, GParamSpec *pspec,
-                       AccountsUI *ui)
-{
-  AccountsUIPrivate *priv = PRIVATE(ui);
-  gpointer display_name = NULL;
-
-  g_object_get(account_item, "display-name", &display_name, NULL);
-  update_store(GTK_TREE_MODEL(priv->store), account_item,
-               COLUMN_DISPLAY_NAME, display_name, G_TYPE_STRING);
-  g_free(display_name);
-}
-
-static gboolean
-_disconnect_all_items(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter,
-                      gpointer data)
-{
-  gpointer item;
-
-  gtk_tree_model_get(model, iter, COLUMN_ACCOUNT_ITEM, &item, -1);
-
-  if (item)
-  {
-    g_signal_handlers_disconnect_matched(
-      item, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
-      name_notify_cb, data);
-    g_signal_handlers_disconnect_matched(
-      item, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
-      avatar_notify_cb, data);
-    g_signal_handlers_disconnect_matched(
-      item, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
-      draft_notify_cb, data);
-    g_signal_handlers_disconnect_matched(
-      item, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
-      enabled_notify_cb, data);
-    g_signal_handlers_disconnect_matched(
-      item, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
-      display_name_notify_cb, data);
-    g_object_unref(item);
-  }
-
-  return FALSE;
-}
-
-static void
-accounts_ui_finalize(GObject *object)
-{
-  G_OBJECT_CLASS(accounts_ui_parent_class)->finalize(object);
-}
+store_row_deleted_cb(GtkTreeModel *store, GtkTreePath *path, AccountsUI *ui);
 
 static void
 accounts_ui_get_property(GObject *object, guint property_id, GValue *value,
@@ -306,19 +157,24 @@ accounts_ui_destroy(GtkObject *object)
 {
   AccountsUIPrivate *priv = PRIVATE(object);
 
-  if (priv->account_plugin_manager)
-    g_clear_object(&priv->account_plugin_manager);
-
-  if (priv->store)
+  if (priv->model)
   {
-    gtk_tree_model_foreach(GTK_TREE_MODEL(priv->store),
-                           _disconnect_all_items, object);
-    gtk_list_store_clear(priv->store);
-    g_clear_object(&priv->store);
-  }
+    GtkTreeModel *store = accounts_ui_model_get_store(priv->model);
 
-  if (priv->avatar_icon)
-    g_clear_object(&priv->avatar_icon);
+    g_signal_handlers_disconnect_matched(
+      priv->model, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+      model_initialized_cb, object);
+    g_signal_handlers_disconnect_matched(
+      priv->model, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+      model_plugin_initialized_cb, object);
+    g_signal_handlers_disconnect_matched(
+      store, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+      store_row_inserted_cb, object);
+    g_signal_handlers_disconnect_matched(
+      store, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+      store_row_deleted_cb, object);
+    g_clear_object(&priv->model);
+  }
 
   if (priv->parent_window)
     g_clear_object(&priv->parent_window);
@@ -367,13 +223,63 @@ accounts_ui_size_request(GtkWidget *widget, GtkRequisition *requisition)
   GTK_WIDGET_CLASS(accounts_ui_parent_class)->size_request(widget, requisition);
 }
 
+static void
+accounts_ui_style_set(GtkWidget *widget, GtkStyle *previous_style)
+{
+  AccountsUIPrivate *priv = PRIVATE(widget);
+
+  GTK_WIDGET_CLASS(accounts_ui_parent_class)->style_set(widget,
+                                                        previous_style);
+
+  if (priv->model)
+    accounts_ui_model_update_style(priv->model);
+}
+
+/* the accounts are kept by the shared model, the dialog only forwards */
+static void
+_accounts_list_add(AccountsList *accounts_list, AccountItem *account_item)
+{
+  AccountsUIPrivate *priv = PRIVATE(accounts_list);
+
+  g_return_if_fail(priv->model != NULL);
+
+  accounts_list_add(ACCOUNTS_LIST(priv->model), account_item);
+}
+
+static GList *
+_accounts_list_get_all(AccountsList *accounts_list)
+{
+  AccountsUIPrivate *priv = PRIVATE(accounts_list);
+
+  g_return_val_if_fail(priv->model != NULL, NULL);
+
+  return accounts_list_get_all(ACCOUNTS_LIST(priv->model));
+}
+
+static void
+_accounts_list_remove(AccountsList *accounts_list, AccountItem *account_item)
+{
+  AccountsUIPrivate *priv = PRIVATE(accounts_list);
+
+  g_return_if_fail(priv->model != NULL);
+
+  accounts_list_remove(ACCOUNTS_LIST(priv->model), account_item);
+}
+
+static void
+accounts_list_iface_init(AccountsListIface *iface)
+{
+  iface->add = _accounts_list_add;
+  iface->get_all = _accounts_list_get_all;
+  iface->remove = _accounts_list_remove;
+}
+
 static void
 accounts_ui_class_init(AccountsUIClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS(klass);
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
 
-  object_class->finalize = accounts_ui_finalize;
   object_class->set_property = accounts_ui_set_property;
   object_class->get_property = accounts_ui_get_property;
 
@@ -382,6 +288,7 @@ accounts_ui_class_init(AccountsUIClass *klass)
   widget_class->realize = accounts_ui_realize;
 #endif
   widget_class->size_request = accounts_ui_size_request;
+  widget_class->style_set = accounts_ui_style_set;
 
   g_object_class_install_property(
     object_class, PROP_INITIALIZED,
@@ -399,40 +306,11 @@ accounts_ui_class_init(AccountsUIClass *klass)
       "",
       GDK_TYPE_WINDOW,
       G_PARAM_STATIC_BLURB | G_PARAM_STATIC_NICK | G_PARAM_READWRITE));
-}
-
-static gboolean
-foreach_func(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter,
-             gpointer data)
-{
-  gpointer item;
-  GList **l = data;
-
-  gtk_tree_model_get(model, iter, COLUMN_ACCOUNT_ITEM, &item, -1);
-
-  if (item)
-  {
-    g_object_unref(item);
-    *l = g_list_prepend(*l, item);
-  }
 
-  return FALSE;
-}
-
-static GList *
-_accounts_list_get_all(AccountsList *accounts_list)
-{
-  AccountsUIPrivate *priv;
-  GList *l = NULL;
-
-  g_return_val_if_fail(ACCOUNTS_IS_UI(accounts_list), NULL);
-
-  priv = PRIVATE(accounts_list);
-
-  if (priv->store)
-    gtk_tree_model_foreach(GTK_TREE_MODEL(priv->store), foreach_func, &l);
-
-  return l;
+  signals[PLUGIN_INITIALIZED] = g_signal_new(
+      "plugin-initialized", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST,
+      0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT,
+      G_TYPE_NONE, 1, ACCOUNT_TYPE_PLUGIN);
 }
 
 static void
@@ -446,57 +324,24 @@ select_first_row(GtkTreeView *tree_view)
   }
 }
 
-static void
-_accounts_list_remove(AccountsList *accounts_list, AccountItem *account_item)
+static gboolean
+is_store_empty(AccountsUIPrivate *priv)
 {
-  AccountsUIPrivate *priv;
   GtkTreeIter iter;
 
-  g_return_if_fail(ACCOUNTS_IS_UI(accounts_list));
-  g_return_if_fail(ACCOUNT_IS_ITEM(account_item));
-
-  priv = PRIVATE(accounts_list);
-  priv->store = priv->store;
+  return !gtk_tree_model_get_iter_first(
+        accounts_ui_model_get_store(priv->model), &iter);
+}
 
-  if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(priv->store), &iter))
+static void
+update_list_visibility(AccountsUIPrivate *priv)
+{
+  if (!is_store_empty(priv))
   {
-    do
-    {
-      AccountItem *item = NULL;
-
-      gtk_tree_model_get(GTK_TREE_MODEL(priv->store), &iter,
-                         COLUMN_ACCOUNT_ITEM, &item,
-                         -1);
-
-      if (item)
-        g_object_unref(item);
-
-      if (item == account_item)
-      {
-        g_signal_handlers_disconnect_matched(
-          item, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
-          name_notify_cb, accounts_list);
-        g_signal_handlers_disconnect_matched(
-          item, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
-          avatar_notify_cb, accounts_list);
-        g_signal_handlers_disconnect_matched(
-          item, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
-          draft_notify_cb, accounts_list);
-        g_signal_handlers_disconnect_matched(
-          item, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
-          enabled_notify_cb, accounts_list);
-        g_signal_handlers_disconnect_matched(
-          item, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
-          display_name_notify_cb, accounts_list);
-        gtk_list_store_remove(priv->store, &iter);
-        break;
-      }
-    }
-    while (gtk_tree_model_iter_next(GTK_TREE_MODEL(priv->store), &iter));
-  }
-
-  if (priv->store->length)
+    gtk_widget_hide(priv->label);
+    gtk_widget_show(priv->pannable_area);
     select_first_row(GTK_TREE_VIEW(priv->tree_view));
+  }
   else
   {
     gtk_widget_show(priv->label);
@@ -505,81 +350,22 @@ _accounts_list_remove(AccountsList *accounts_list, AccountItem *account_item)
 }
 
 static void
-_accounts_list_add(AccountsList *accounts_list, AccountItem *account_item)
+store_row_inserted_cb(GtkTreeModel *store, GtkTreePath *path,
+                      GtkTreeIter *iter, AccountsUI *ui)
 {
-  AccountsUIPrivate *priv;
-  gpointer service_icon = NULL;
-  gpointer avatar = NULL;
-  gpointer service_name = NULL;
-  gpointer display_name = NULL;
-  gpointer name = NULL;
-  gboolean draft = FALSE;
-  gboolean enabled = FALSE;
-  gboolean supports_avatar = FALSE;
-
-  g_return_if_fail(ACCOUNTS_IS_UI(accounts_list));
-  g_return_if_fail(ACCOUNT_IS_ITEM(account_item));
-
-  priv = PRIVATE(accounts_list);
-
-  g_object_get(account_item,
-               "name", &name,
-               "avatar", &avatar,
-               "enabled", &enabled,
-               "draft", &draft,
-               "display-name", &display_name,
-               "service-name", &service_name,
-               "service-icon", &service_icon,
-               "supports-avatar", &supports_avatar,
-               NULL);
-  g_signal_connect(account_item, "notify::name",
-                   G_CALLBACK(name_notify_cb), accounts_list);
-  g_signal_connect(account_item, "notify::avatar",
-                   G_CALLBACK(avatar_notify_cb), accounts_list);
-  g_signal_connect(account_item, "notify::enabled",
-                   G_CALLBACK(enabled_notify_cb), accounts_list);
-  g_signal_connect(account_item, "notify::draft",
-                   G_CALLBACK(draft_notify_cb), accounts_list);
-  g_signal_connect(account_item, "notify::display-name",
-                   G_CALLBACK(display_name_notify_cb), accounts_list);
-
-  if (!avatar && supports_avatar && priv->avatar_icon)
-    avatar = g_object_ref(priv->avatar_icon);
-
-  gtk_list_store_insert_with_values(priv->store, NULL, 0,
-                                    COLUMN_AVATAR, avatar,
-                                    COLUMN_NAME, name,
-                                    COLUMN_DISPLAY_NAME, display_name,
-                                    COLUMN_SERVICE_NAME, service_name,
-                                    COLUMN_SERVICE_ICON, service_icon,
-                                    COLUMN_ENABLED, enabled,
-                                    COLUMN_DRAFT, draft,
-                                    COLUMN_ACCOUNT_ITEM, account_item,
-                                    -1);
-  g_free(name);
-  g_free(display_name);
-  g_free(service_name);
-
-  if (avatar)
-    g_object_unref(avatar);
-
-  if (service_icon)
-    g_object_unref(service_icon);
-
-  if (priv->store->length == 1)
-  {
-    gtk_widget_hide(priv->label);
-    gtk_widget_show(priv->pannable_area);
-    select_first_row(GTK_TREE_VIEW(priv->tree_view));
-  }
+  AccountsUIPrivate *priv = PRIVATE(ui);
+
+  if (priv->initialized && gtk_tree_model_iter_n_children(store, NULL) == 1)
+    update_list_visibility(priv);
 }
 
 static void
-accounts_list_iface_init(AccountsListIface *iface)
+store_row_deleted_cb(GtkTreeModel *store, GtkTreePath *path, AccountsUI *ui)
 {
-  iface->add = _accounts_list_add;
-  iface->get_all = _accounts_list_get_all;
-  iface->remove = _accounts_list_remove;
+  AccountsUIPrivate *priv = PRIVATE(ui);
+
+  if (priv->initialized)
+    update_list_visibility(priv);
 }
 
 static void
@@ -587,7 +373,7 @@ on_dialog_destroy(GtkObject *object, gpointer user_data)
 {
   AccountsUI *ui = user_data;
 
-  if (PRIVATE(ui)->store->length)
+  if (!is_store_empty(PRIVATE(ui)))
     gtk_widget_show(GTK_WIDGET(ui));
   else
   {
@@ -606,240 +392,102 @@ on_wizard_dialog_destroy(GtkObject *object, gpointer user_data)
 }
 
 static void
-plugin_initialization_done(AccountsUI *ui)
+show_initialized(AccountsUI *ui)
 {
   AccountsUIPrivate *priv = PRIVATE(ui);
 
-  g_return_if_fail(priv->plugins_initialized_lock > 0);
-
-  priv->plugins_initialized_lock--;
-
-  if (!priv->plugins_initialized_lock)
+  if (!is_store_empty(priv))
+    gtk_widget_show(GTK_WIDGET(ui));
+  else
   {
-    priv->initialized = TRUE;
-    g_object_notify(G_OBJECT(ui), "initialized");
+    GtkWidget *dialog;
 
-    if (!priv->store || priv->store->length)
-    {
-      if (priv->show)
-        gtk_widget_show(GTK_WIDGET(ui));
-    }
-    else if (priv->show)
+    /* the list of the last run might be shown already */
+    gtk_widget_hide(GTK_WIDGET(ui));
+    dialog = accounts_ui_dialogs_get_new_account(GTK_WIDGET(ui), NULL);
+
+    if (dialog)
     {
-      GtkWidget *dialog = accounts_ui_dialogs_get_new_account(GTK_WIDGET(ui),
-                                                              NULL);
-
-      if (dialog)
-      {
-        gtk_widget_show(dialog);
-        g_signal_connect_after(dialog, "destroy",
-                               G_CALLBACK(on_dialog_destroy), ui);
-      }
+      gtk_widget_show(dialog);
+      g_signal_connect_after(dialog, "destroy",
+                             G_CALLBACK(on_dialog_destroy), ui);
     }
   }
 }
 
 static void
-on_plugin_initialized(AccountPlugin *plugin, GParamSpec *pspec, AccountsUI *ui)
-{
-  gboolean initialized = FALSE;
-
-  g_object_get(plugin, "initialized", &initialized, NULL);
-
-  if (initialized)
-  {
-    g_signal_handlers_disconnect_matched(
-      plugin, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC,
-      0, 0, NULL, on_plugin_initialized, ui);
-    plugin_initialization_done(ui);
-  }
-}
-
-static gboolean
-idle_plugin_initialization_done(gpointer user_data)
+model_initialized(AccountsUI *ui)
 {
-  AccountsUI *ui = user_data;
-
-  /* we must do the last call in idle, otherwise the caller will not have a
-   * a chance to call accounts_ui_show() if there are no plugins or all plugins
-   * are immediately initialized */
-  plugin_initialization_done(ui);
-  g_object_unref(ui);
-
-  return G_SOURCE_REMOVE;
-}
-
-static void
-init_plugins(AccountsUI *ui)
-{
-  GList *plugin_paths = g_list_prepend(NULL, PLUGINLIBDIR);
   AccountsUIPrivate *priv = PRIVATE(ui);
-  GList *plugins;
-
-  priv->account_plugin_manager =
-    account_plugin_manager_new(plugin_paths, ACCOUNTS_LIST(ui));
-  g_list_free(plugin_paths);
-
-  plugins = account_plugin_manager_list(priv->account_plugin_manager);
-
-  priv->plugins_initialized_lock = 1;
-
-  if (plugins)
-  {
-    GList *l;
-
-    for (l = plugins; l; l = l->next)
-    {
-      gboolean initialized = FALSE;
-
-      priv->plugins_initialized_lock++;
-
-      g_object_get(l->data, "initialized", &initialized, NULL);
 
-      if (!initialized)
-      {
-        g_signal_connect(l->data, "notify::initialized",
-                         G_CALLBACK(on_plugin_initialized), ui);
-      }
-      else
-        plugin_initialization_done(ui);
-    }
-
-    g_list_free(plugins);
-  }
-  else
-    gtk_widget_set_sensitive(priv->button_new, FALSE);
+  /* the model is shared, so the list might be complete already */
+  gtk_tree_view_set_model(GTK_TREE_VIEW(priv->tree_view),
+                          accounts_ui_model_get_store(priv->model));
+  gtk_widget_set_sensitive(priv->button_new,
+                           accounts_ui_model_has_plugins(priv->model));
+  update_list_visibility(priv);
+  priv->initialized = TRUE;
+  g_object_notify(G_OBJECT(ui), "initialized");
 
-  g_idle_add_full(G_PRIORITY_HIGH_IDLE, idle_plugin_initialization_done,
-                  g_object_ref(ui), NULL);
+  if (priv->show)
+    show_initialized(ui);
 }
 
-static gint
-sort_func(GtkTreeModel *model, GtkTreeIter *a, GtkTreeIter *b,
-          gpointer user_data)
+static void
+model_initialized_cb(AccountsUIModel *model, GParamSpec *pspec,
+                     AccountsUI *ui)
 {
-  gint rv;
-
-  if (GPOINTER_TO_INT(user_data) == COLUMN_ENABLED)
+  if (accounts_ui_model_is_initialized(model))
   {
-    gboolean ena = FALSE;
-    gboolean enb = FALSE;
-
-    gtk_tree_model_get(model, a, COLUMN_ENABLED, &ena, -1);
-    gtk_tree_model_get(model, b, COLUMN_ENABLED, &enb, -1);
-
-    rv = enb - ena;
-  }
-  else
-  {
-    gchar *vala = NULL;
-    gchar *valb = NULL;
-
-    gtk_tree_model_get(model, a, user_data, &vala, -1);
-    gtk_tree_model_get(model, b, user_data, &valb, -1);
-
-    if (vala)
-    {
-      if (valb)
-        rv = strcmp(vala, valb);
-      else
-        rv = 1;
-    }
-    else
-      rv = -(valb != 0);
-
-    g_free(vala);
-    g_free(valb);
+    g_signal_handlers_disconnect_matched(
+      model, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC,
+      0, 0, NULL, model_initialized_cb, ui);
+    g_signal_handlers_disconnect_matched(
+      model, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC,
+      0, 0, NULL, model_plugin_initialized_cb, ui);
+    model_initialized(ui);
   }
-
-  return rv;
 }
 
-static const char *
-get_text_color(const gchar *id)
+static void
+model_plugin_initialized_cb(AccountsUIModel *model, AccountPlugin *plugin,
+                            AccountsUI *ui)
 {
-  static char buf[40];
-  GdkColor color;
-  GtkStyle *style = gtk_rc_get_style_by_paths(
-      gtk_settings_get_default(), NULL, NULL, GTK_TYPE_LABEL);
-
-  if (gtk_style_lookup_color(style, id, &color))
-  {
-    sprintf(buf, "#%02x%02x%02x",
-            color.red >> 8, color.green >> 8, color.blue >> 8);
-  }
-
-  return buf;
+  g_signal_emit(ui, signals[PLUGIN_INITIALIZED], 0, plugin);
 }
 
 static void
-status_data_func(GtkTreeViewColumn *tree_column, GtkCellRenderer *cell,
-                 GtkTreeModel *tree_model, GtkTreeIter *iter, gpointer data)
+on_content_resize(GtkWidget *widget, GtkRequisition *requisition,
+                  AccountsUI *ui)
 {
-  const char *color = get_text_color("ActiveTextColor");
-  const char *span;
-  gchar *markup;
-  gboolean draft;
-  gboolean enabled;
-
-  gtk_tree_model_get(tree_model, iter,
-                     COLUMN_ENABLED, &enabled,
-                     COLUMN_DRAFT, &draft,
-                     -1);
-
-  if (draft)
-    span = _("accounts_fi_draft");
-  else if (enabled)
-    span = _("accounts_fi_enabled");
-  else
-    span = _("accounts_fi_disabled");
-
-  markup = g_markup_printf_escaped(
-      "<span size=\"x-small\" foreground=\"%s\">%s</span>", color, span);
-  g_object_set(cell, "markup", markup, NULL);
-  g_free(markup);
+  gtk_widget_queue_resize(GTK_WIDGET(ui));
 }
 
-static void
-user_name_data_func(GtkTreeViewColumn *tree_column, GtkCellRenderer *cell,
-                    GtkTreeModel *tree_model, GtkTreeIter *iter, gpointer data)
+/* only connected when tracing, marks when the first rows get painted */
+static gboolean
+tree_view_expose_event_cb(GtkWidget *tree_view, GdkEventExpose *event,
+                          AccountsUI *ui)
 {
-  gchar *display_name = NULL;
-  gchar *name = NULL;
+  AccountsUIPrivate *priv = PRIVATE(ui);
+  GtkTreeModel *model = gtk_tree_view_get_model(GTK_TREE_VIEW(tree_view));
 
-  gtk_tree_model_get(tree_model, iter,
-                     COLUMN_NAME, &name,
-                     COLUMN_DISPLAY_NAME, &display_name,
-                     -1);
+  if (!model || !gtk_tree_model_iter_n_children(model, NULL))
+    return FALSE;
 
-  if (name && *name)
+  if (model == accounts_ui_model_get_store(priv->model))
   {
-    if (display_name && *display_name)
-    {
-      gchar *markup = g_markup_printf_escaped(
-          "%s\n<span size=\"x-small\" foreground=\"%s\">%s</span>", name,
-          get_text_color("SecondaryTextColor"), display_name);
-
-      g_object_set(cell, "markup", markup, NULL);
-      g_free(markup);
-    }
-    else
-      g_object_set(cell, "text", name, NULL);
+    rtcom_trace_mark("accounts-expose", NULL);
+    g_signal_handlers_disconnect_matched(
+      tree_view, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC,
+      0, 0, NULL, tree_view_expose_event_cb, ui);
+  }
+  else if (!priv->snapshot_exposed)
+  {
+    priv->snapshot_exposed = TRUE;
+    rtcom_trace_mark("snapshot-expose", NULL);
   }
-  else if (display_name && *display_name)
-    g_object_set(cell, "text", NULL);
-  else
-    g_object_set(cell, "text", "", NULL);
-
-  g_free(name);
-  g_free(display_name);
-}
 
-static void
-on_content_resize(GtkWidget *widget, GtkRequisition *requisition,
-                  AccountsUI *ui)
-{
-  gtk_widget_queue_resize(GTK_WIDGET(ui));
+  return FALSE;
 }
 
 static void
@@ -867,16 +515,20 @@ tree_view_row_activated_cb(GtkTreeView *self, GtkTreePath *path,
 {
   AccountsUI *ui = user_data;
   AccountsUIPrivate *priv = PRIVATE(ui);
+  GtkTreeModel *store;
   GtkTreeIter iter;
   AccountItem *item = NULL;
 
-  if (priv->wizard_active)
+  /* snapshot rows have no account item */
+  if (priv->wizard_active || !priv->initialized)
     return;
 
-  if (gtk_tree_model_get_iter(GTK_TREE_MODEL(priv->store), &iter, path))
+  store = accounts_ui_model_get_store(priv->model);
+
+  if (gtk_tree_model_get_iter(store, &iter, path))
   {
-    gtk_tree_model_get(GTK_TREE_MODEL(priv->store), &iter,
-                       COLUMN_ACCOUNT_ITEM, &item,
+    gtk_tree_model_get(store, &iter,
+                       ACCOUNTS_UI_COLUMN_ACCOUNT_ITEM, &item,
                        -1);
   }
 
@@ -886,9 +538,10 @@ tree_view_row_activated_cb(GtkTreeView *self, GtkTreePath *path,
 
     priv->wizard_active = TRUE;
     wizard = accounts_wizard_dialog_new(
-        GTK_WINDOW(ui), priv->account_plugin_manager, item, NULL);
+        GTK_WINDOW(ui), accounts_ui_model_get_plugin_manager(priv->model),
+        item, NULL);
     g_signal_connect(wizard, "delete-account",
-                     G_CALLBACK(delete_account), ui);
+                     G_CALLBACK(delete_account), priv->model);
     g_signal_connect(wizard, "destroy",
                      G_CALLBACK(on_wizard_dialog_destroy), ui);
     gtk_widget_show(wizard);
@@ -904,35 +557,18 @@ accounts_ui_init(AccountsUI *ui)
   GtkWidget *tree_view;
   GtkTreeViewColumn *column;
   GtkCellRenderer *renderer;
-
-  priv->store = gtk_list_store_new(8, GDK_TYPE_PIXBUF, G_TYPE_STRING,
-                                   G_TYPE_STRING, G_TYPE_STRING,
-                                   GDK_TYPE_PIXBUF, G_TYPE_INT, G_TYPE_INT,
-                                   ACCOUNT_TYPE_ITEM);
-
-  gtk_tree_sortable_set_sort_func(
-    GTK_TREE_SORTABLE(priv->store), COLUMN_NAME,
-    sort_func, GINT_TO_POINTER(COLUMN_NAME), NULL);
-  gtk_tree_sortable_set_sort_func(
-    GTK_TREE_SORTABLE(priv->store), COLUMN_SERVICE_NAME,
-    sort_func, GINT_TO_POINTER(COLUMN_SERVICE_NAME), NULL);
-  gtk_tree_sortable_set_sort_func(
-    GTK_TREE_SORTABLE(priv->store), COLUMN_ENABLED,
-    sort_func, GINT_TO_POINTER(COLUMN_ENABLED), NULL);
-
-  gtk_tree_sortable_set_sort_column_id(
-    GTK_TREE_SORTABLE(priv->store), COLUMN_NAME, GTK_SORT_ASCENDING);
+  GtkTreeModel *store;
 
   priv->pannable_area = g_object_new(HILDON_TYPE_PANNABLE_AREA,
                                      "hscrollbar-policy", GTK_POLICY_NEVER,
                                      "vscrollbar-policy", GTK_POLICY_AUTOMATIC,
                                      NULL);
   tree_view = g_object_new(GTK_TYPE_TREE_VIEW,
-                           "model", priv->store,
                            "headers-visible", FALSE,
                            NULL);
 
-  gtk_tree_view_set_search_column(GTK_TREE_VIEW(tree_view), COLUMN_NAME);
+  gtk_tree_view_set_search_column(GTK_TREE_VIEW(tree_view),
+                                  ACCOUNTS_UI_COLUMN_NAME);
   gtk_tree_selection_set_mode(
     gtk_tree_view_get_selection(GTK_TREE_VIEW(tree_view)),
     GTK_SELECTION_BROWSE);
@@ -944,8 +580,9 @@ accounts_ui_init(AccountsUI *ui)
                           NULL);
   gtk_tree_view_column_pack_start(column, renderer, FALSE);
   gtk_tree_view_column_add_attribute(column, renderer, "pixbuf",
-                                     COLUMN_SERVICE_ICON);
-  gtk_tree_view_column_set_sort_column_id(column, COLUMN_SERVICE_NAME);
+                                     ACCOUNTS_UI_COLUMN_SERVICE_ICON);
+  gtk_tree_view_column_set_sort_column_id(column,
+                                          ACCOUNTS_UI_COLUMN_SERVICE_NAME);
   gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 
   column = g_object_new(GTK_TYPE_TREE_VIEW_COLUMN,
@@ -957,10 +594,10 @@ accounts_ui_init(AccountsUI *ui)
                           "ellipsize", 3,
                           NULL);
   gtk_tree_view_column_pack_start(column, renderer, TRUE);
-  gtk_tree_view_column_set_sort_column_id(column, COLUMN_NAME);
+  gtk_tree_view_column_set_sort_column_id(column, ACCOUNTS_UI_COLUMN_NAME);
   gtk_tree_view_append_column(GTK_TREE_VIEW( tree_view), column);
-  gtk_tree_view_column_set_cell_data_func(
-    column, renderer, user_name_data_func, NULL, NULL);
+  gtk_tree_view_column_add_attribute(column, renderer, "markup",
+                                     ACCOUNTS_UI_COLUMN_USER_NAME_MARKUP);
 
   column = g_object_new(GTK_TYPE_TREE_VIEW_COLUMN,
                         "sizing", TRUE,
@@ -972,9 +609,9 @@ accounts_ui_init(AccountsUI *ui)
                           "xalign", 1.0,
                           NULL);
   gtk_tree_view_column_pack_start(column, renderer, FALSE);
-  gtk_tree_view_column_set_sort_column_id(column, COLUMN_ENABLED);
-  gtk_tree_view_column_set_cell_data_func(
-    column, renderer, status_data_func, NULL, NULL);
+  gtk_tree_view_column_set_sort_column_id(column, ACCOUNTS_UI_COLUMN_ENABLED);
+  gtk_tree_view_column_add_attribute(column, renderer, "markup",
+                                     ACCOUNTS_UI_COLUMN_STATUS_MARKUP);
   gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 
   column = g_object_new(GTK_TYPE_TREE_VIEW_COLUMN, NULL);
@@ -982,7 +619,8 @@ accounts_ui_init(AccountsUI *ui)
                           "stock-size", HILDON_ICON_SIZE_FINGER,
                           NULL);
   gtk_tree_view_column_pack_start(column, renderer, FALSE);
-  gtk_tree_view_column_add_attribute(column, renderer, "pixbuf", COLUMN_AVATAR);
+  gtk_tree_view_column_add_attribute(column, renderer, "pixbuf",
+                                     ACCOUNTS_UI_COLUMN_AVATAR);
   gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
 
   priv->tree_view = tree_view;
@@ -990,6 +628,12 @@ accounts_ui_init(AccountsUI *ui)
   g_signal_connect(tree_view, "row-activated",
                    G_CALLBACK(tree_view_row_activated_cb), ui);
 
+  if (rtcom_trace_is_enabled())
+  {
+    g_signal_connect_after(tree_view, "expose-event",
+                           G_CALLBACK(tree_view_expose_event_cb), ui);
+  }
+
   priv->label = g_object_new(GTK_TYPE_LABEL,
                              "label", _("accounts_ia_no_accounts"),
                              "xalign", 0.5,
@@ -1018,11 +662,38 @@ accounts_ui_init(AccountsUI *ui)
   gtk_widget_show_all(vbox);
   gtk_widget_show(priv->button_new);
 
-  priv->avatar_icon = gtk_icon_theme_load_icon(
-      gtk_icon_theme_get_default(),
-      "general_default_avatar", HILDON_ICON_PIXEL_SIZE_FINGER, 0, NULL);
+  priv->model = accounts_ui_model_dup_default();
+  store = accounts_ui_model_get_store(priv->model);
+  g_signal_connect(store, "row-inserted",
+                   G_CALLBACK(store_row_inserted_cb), ui);
+  g_signal_connect(store, "row-deleted",
+                   G_CALLBACK(store_row_deleted_cb), ui);
+
+  if (accounts_ui_model_is_initialized(priv->model))
+    model_initialized(ui);
+  else
+  {
+    GtkTreeModel *snapshot = accounts_ui_model_get_snapshot(priv->model);
+
+    /* show the list of the last run until the plugins are initialized.
+     * Rows have no account item, so they can't be activated, nor new
+     * accounts created until the list is live */
+    if (snapshot)
+    {
+      gtk_tree_view_set_model(GTK_TREE_VIEW(tree_view), snapshot);
+      gtk_widget_hide(priv->label);
+      gtk_widget_show(priv->pannable_area);
+      gtk_widget_set_sensitive(priv->button_new, FALSE);
+    }
+    else if (!accounts_ui_model_has_plugins(priv->model))
+      gtk_widget_set_sensitive(priv->button_new, FALSE);
+
+    g_signal_connect(priv->model, "notify::initialized",
+                     G_CALLBACK(model_initialized_cb), ui);
+    g_signal_connect(priv->model, "plugin-initialized",
+                     G_CALLBACK(model_plugin_initialized_cb), ui);
+  }
 
-  init_plugins(ui);
   gtk_window_set_title(GTK_WINDOW(ui), _("accounts_ti_accounts"));
   gtk_window_set_default_size(GTK_WINDOW(ui), -1, 280);
   gtk_window_set_modal(GTK_WINDOW(ui), FALSE);
@@ -1035,67 +706,45 @@ accounts_ui_dialogs_get_edit_account(GtkWidget *accounts_ui,
                                      const char *user_name)
 {
   AccountsUIPrivate *priv;
-  GtkTreeIter iter;
+  AccountItem *account;
 
   g_return_val_if_fail(ACCOUNTS_IS_UI(accounts_ui), NULL);
   g_return_val_if_fail(user_name != NULL, NULL);
 
   priv = PRIVATE(accounts_ui);
 
-  g_return_val_if_fail(priv->initialized, NULL);
+  g_return_val_if_fail(
+    accounts_ui_model_is_service_ready(priv->model, service_name), NULL);
 
   if (priv->wizard_active)
     return NULL;
 
-  if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(priv->store), &iter))
+  account = accounts_ui_model_find_account(priv->model, service_name,
+                                           user_name);
+
+  if (account)
   {
-    do
+    AccountService *service = account_item_get_service(account);
+    GtkWidget *wizard;
+
+    priv->wizard_active = TRUE;
+
+    wizard = accounts_wizard_dialog_new(
+        GTK_WINDOW(accounts_ui),
+        accounts_ui_model_get_plugin_manager(priv->model), account, service);
+    gtk_window_set_resizable(GTK_WINDOW(wizard), FALSE);
+    g_signal_connect(wizard, "delete-account",
+                     G_CALLBACK(delete_account), priv->model);
+    g_signal_connect(wizard, "destroy",
+                     G_CALLBACK(on_wizard_dialog_destroy), accounts_ui);
+
+    if (!gtk_widget_get_visible(accounts_ui) && priv->parent_window)
     {
-      AccountService *service;
-      AccountItem *account;
-      gchar *_service_name;
-      gchar *_user_name;
-
-      gtk_tree_model_get(GTK_TREE_MODEL(priv->store), &iter,
-                         COLUMN_ACCOUNT_ITEM, &account,
-                         -1);
-      g_object_get(account, "name", &_user_name, NULL);
-      service = account_item_get_service(account);
-      g_object_get(service, "name", &_service_name, NULL);
-
-      if (!g_strcmp0(_user_name, user_name) &&
-          !g_strcmp0(_service_name, service_name))
-      {
-        GtkWidget *wizard;
-
-        g_free(_user_name);
-        g_free(_service_name);
-        priv->wizard_active = TRUE;
-
-        wizard = accounts_wizard_dialog_new(
-            GTK_WINDOW(accounts_ui), priv->account_plugin_manager,
-            account, service);
-        gtk_window_set_resizable(GTK_WINDOW(wizard), FALSE);
-        g_signal_connect(wizard, "delete-account",
-                         G_CALLBACK(delete_account), accounts_ui);
-        g_signal_connect(wizard, "destroy",
-                         G_CALLBACK(on_wizard_dialog_destroy), accounts_ui);
-        g_object_unref(account);
-
-        if (!gtk_widget_get_visible(accounts_ui) && priv->parent_window)
-        {
-          gtk_widget_realize(wizard);
-          gdk_window_set_transient_for(wizard->window, priv->parent_window);
-        }
-
-        return wizard;
-      }
-
-      g_free(_user_name);
-      g_free(_service_name);
-      g_object_unref(account);
+      gtk_widget_realize(wizard);
+      gdk_window_set_transient_for(wizard->window, priv->parent_window);
     }
-    while (gtk_tree_model_iter_next(GTK_TREE_MODEL(priv->store), &iter));
+
+    return wizard;
   }
 
   g_warning("Unknown account %s for service %s", user_name, service_name);
@@ -1127,6 +776,21 @@ accounts_ui_show(GtkWidget *accounts_ui)
   g_return_if_fail(ACCOUNTS_IS_UI(accounts_ui));
 
   PRIVATE(accounts_ui)->show = TRUE;
+
+  /* the dialog might have been created in advance and already be
+   * initialized, e.g. by a service in warm standby */
+  if (PRIVATE(accounts_ui)->initialized)
+    show_initialized(ACCOUNTS_UI(accounts_ui));
+  /* no need to wait for the plugins if there is something to show */
+  else
+  {
+    GtkTreeModel *model = gtk_tree_view_get_model(
+        GTK_TREE_VIEW(PRIVATE(accounts_ui)->tree_view));
+    GtkTreeIter iter;
+
+    if (model && gtk_tree_model_get_iter_first(model, &iter))
+      gtk_widget_show(accounts_ui);
+  }
 }
 
 GtkWidget *
@@ -1170,40 +834,15 @@ accounts_ui_dialogs_get_new_account(GtkWidget *accounts_ui,
 
   if (service_name && *service_name)
   {
-    GList *plugins = account_plugin_manager_list(priv->account_plugin_manager);
-    GList *p;
-
-    for (p = plugins; p; p = p->next)
-    {
-      if (p->data)
-      {
-        GList *services = account_plugin_list_services(p->data);
-        GList *s;
-
-        for (s = services; s; s = s->next)
-        {
-          if (s->data)
-          {
-            if (!g_strcmp0(account_service_get_name(s->data), service_name))
-            {
-              service = s->data;
-              break;
-            }
-          }
-        }
-
-        g_list_free(services);
-      }
-    }
-
-    g_list_free(plugins);
+    service = accounts_ui_model_find_service(priv->model, service_name);
 
     if (!service)
       return NULL;
   }
 
   wizard = accounts_wizard_dialog_new(
-      GTK_WINDOW(accounts_ui), priv->account_plugin_manager, NULL, service);
+      GTK_WINDOW(accounts_ui),
+      accounts_ui_model_get_plugin_manager(priv->model), NULL, service);
   g_signal_connect(wizard, "destroy",
                    G_CALLBACK(on_wizard_dialog_destroy), accounts_ui);
 
@@ -1216,6 +855,15 @@ accounts_ui_dialogs_get_new_account(GtkWidget *accounts_ui,
   return wizard;
 }
 
+gboolean
+accounts_ui_is_service_ready(GtkWidget *accounts_ui, const char *service_name)
+{
+  g_return_val_if_fail(ACCOUNTS_IS_UI(accounts_ui), FALSE);
+
+  return accounts_ui_model_is_service_ready(PRIVATE(accounts_ui)->model,
+                                            service_name);
+}
+
 gboolean
 accounts_ui_get_is_empty(GtkWidget *accounts_ui)
 {
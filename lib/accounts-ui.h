@@ -66,6 +66,8 @@ accounts_ui_set_parent(GtkWidget *accounts_ui,
 void
 accounts_ui_show(GtkWidget *accounts_ui);
 
+/* Can be called as soon as accounts_ui_is_service_ready() returns TRUE for
+ * @service_name, before the dialog itself is initialized. */
 GtkWidget *
 accounts_ui_dialogs_get_edit_account(GtkWidget *accounts_ui,
                                      const char *service_name,
@@ -75,4 +77,11 @@ GtkWidget *
 accounts_ui_dialogs_get_new_account(GtkWidget *accounts_ui,
                                     const char *service_name);
 
+/* Whether accounts of @service_name can already be edited, i.e. the plugin
+ * providing it is initialized. "plugin-initialized" is emitted on the dialog
+ * each time another plugin becomes initialized. */
+gboolean
+accounts_ui_is_service_ready(GtkWidget *accounts_ui,
+                             const char *service_name);
+
 #endif /* ACCOUNTSUI_H */
@@ -55,7 +55,8 @@ enum
 {
   PROP_DBUS_CONNECTION = 1,
   PROP_PARENT_XID,
-  PROP_VISIBLE
+  PROP_VISIBLE,
+  PROP_ACCOUNTS_UI
 };
 
 enum
@@ -89,25 +90,6 @@ aui_instance_close(AuiInstance *instance, GError **error)
 
 #include "dbus-glib-marshal-aui-instance.h"
 
-static GObject *
-accounts_ui_constructor(GType type, guint n_construct_properties,
-                        GObjectConstructParam *construct_properties)
-{
-  GObject *instance = G_OBJECT_CLASS(aui_instance_parent_class)->
-    constructor(type, n_construct_properties, construct_properties);
-  AuiInstancePrivate *priv = PRIVATE(instance);
-
-  if (priv->dbus_gconnection)
-  {
-    dbus_g_connection_register_g_object(priv->dbus_gconnection,
-                                        priv->object_path, instance);
-  }
-  else
-    g_clear_object(&instance);
-
-  return instance;
-}
-
 static void
 accounts_ui_destroy_cb(GtkWidget *accounts_ui, AuiInstance *instance)
 {
@@ -156,6 +138,43 @@ accounts_ui_unmap_cb(GtkWidget *accounts_ui, AuiInstance *instance)
   PRIVATE(instance)->unmapped = TRUE;
 }
 
+static GObject *
+accounts_ui_constructor(GType type, guint n_construct_properties,
+                        GObjectConstructParam *construct_properties)
+{
+  GObject *instance = G_OBJECT_CLASS(aui_instance_parent_class)->
+    constructor(type, n_construct_properties, construct_properties);
+  AuiInstancePrivate *priv = PRIVATE(instance);
+
+  if (priv->dbus_gconnection)
+  {
+    dbus_g_connection_register_g_object(priv->dbus_gconnection,
+                                        priv->object_path, instance);
+  }
+  else
+  {
+    /* a passed in dialog is destroyed on dispose */
+    g_clear_object(&instance);
+    return instance;
+  }
+
+  if (!priv->accounts_ui)
+    priv->accounts_ui = g_object_new(ACCOUNTS_TYPE_UI, NULL);
+
+  g_assert(ACCOUNTS_IS_UI(priv->accounts_ui));
+
+  g_signal_connect(priv->accounts_ui, "destroy",
+                   G_CALLBACK(accounts_ui_destroy_cb), instance);
+  g_signal_connect(priv->accounts_ui, "realize",
+                   G_CALLBACK(accounts_ui_realize_cb), instance);
+  g_signal_connect(priv->accounts_ui, "unmap-event",
+                   G_CALLBACK(accounts_ui_unmap_event_cb), instance);
+  g_signal_connect(priv->accounts_ui, "unmap",
+                   G_CALLBACK(accounts_ui_unmap_cb), instance);
+
+  return instance;
+}
+
 static void
 accounts_ui_dispose(GObject *object)
 {
@@ -310,6 +329,15 @@ accounts_ui_set_property(GObject *object, guint property_id,
       priv->dbus_gconnection = g_value_dup_boxed(value);
       break;
     }
+    case PROP_ACCOUNTS_UI:
+    {
+      AuiInstancePrivate *priv = PRIVATE(object);
+
+      g_assert(priv->accounts_ui == NULL);
+
+      priv->accounts_ui = g_value_get_object(value);
+      break;
+    }
     default:
     {
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
@@ -338,6 +366,14 @@ aui_instance_class_init(AuiInstanceClass *klass)
       "dbus-connection",
       DBUS_TYPE_G_CONNECTION,
       G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE));
+  g_object_class_install_property(
+    object_class, PROP_ACCOUNTS_UI,
+    g_param_spec_object(
+      "accounts-ui",
+      "accounts-ui",
+      "Accounts UI dialog to use instead of creating a new one",
+      ACCOUNTS_TYPE_UI,
+      G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE));
   g_object_class_install_property(
     object_class, PROP_PARENT_XID,
     g_param_spec_uint(
@@ -377,29 +413,19 @@ aui_instance_init(AuiInstance *instance)
   static uint instance_id = 0;
   AuiInstancePrivate *priv = PRIVATE(instance);
 
-  priv->accounts_ui = g_object_new(ACCOUNTS_TYPE_UI, NULL);
-
-  g_assert(ACCOUNTS_IS_UI(priv->accounts_ui));
-
-  g_signal_connect(priv->accounts_ui, "destroy",
-                   G_CALLBACK(accounts_ui_destroy_cb), instance);
-  g_signal_connect(priv->accounts_ui, "realize",
-                   G_CALLBACK(accounts_ui_realize_cb), instance);
-  g_signal_connect(priv->accounts_ui, "unmap-event",
-                   G_CALLBACK(accounts_ui_unmap_event_cb), instance);
-  g_signal_connect(priv->accounts_ui, "unmap",
-                   G_CALLBACK(accounts_ui_unmap_cb), instance);
   priv->object_path = g_strdup_printf("/com/nokia/AccountsUI/instance%u",
                                       ++instance_id);
 }
 
 AuiInstance *
 aui_instance_new(DBusGConnection *dbus_gconnection,
-                 guint xid)
+                 guint xid,
+                 GtkWidget *accounts_ui)
 {
   return g_object_new(AUI_TYPE_INSTANCE,
                       "dbus-connection",
                       dbus_gconnection,
+                      "accounts-ui", accounts_ui,
                       "parent-xid", xid,
                       NULL);
 }
@@ -547,25 +573,64 @@ on_accounts_ui_initialized(AuiInstance *instance)
   priv->context = NULL;
 }
 
-static void
-accounts_ui_initialized_cb(GtkWidget *accounts_ui, GParamSpec *pspec,
-                           AuiInstance *instance)
+static gboolean
+is_service_ready(AuiInstance *instance)
 {
-  gboolean initialized = FALSE;
+  struct auieditdata *data;
+
+  data = g_object_get_data(&instance->parent, "auieditdata");
+
+  /* only the plugin providing the requested service has to be initialized,
+   * the rest of the plugins keep initializing in the background */
+  return !data ||
+         accounts_ui_is_service_ready(PRIVATE(instance)->accounts_ui,
+                                      data->service_name);
+}
 
-  g_object_get(accounts_ui,
-               "initialized", &initialized,
-               NULL);
+static void
+accounts_ui_initialized_cb(GtkWidget *accounts_ui, GParamSpec *pspec,
+                           AuiInstance *instance);
 
-  if (initialized)
+static void
+accounts_ui_plugin_initialized_cb(GtkWidget *accounts_ui,
+                                  GObject *plugin,
+                                  AuiInstance *instance)
+{
+  if (is_service_ready(instance))
   {
     g_signal_handlers_disconnect_matched(
       accounts_ui, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC,
       0, 0, NULL, accounts_ui_initialized_cb, instance);
+    g_signal_handlers_disconnect_matched(
+      accounts_ui, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC,
+      0, 0, NULL, accounts_ui_plugin_initialized_cb, instance);
     on_accounts_ui_initialized(instance);
   }
 }
 
+static void
+accounts_ui_initialized_cb(GtkWidget *accounts_ui, GParamSpec *pspec,
+                           AuiInstance *instance)
+{
+  accounts_ui_plugin_initialized_cb(accounts_ui, NULL, instance);
+}
+
+static void
+wait_for_service(AuiInstance *instance)
+{
+  AuiInstancePrivate *priv = PRIVATE(instance);
+
+  if (is_service_ready(instance))
+    on_accounts_ui_initialized(instance);
+  else
+  {
+    g_signal_connect(priv->accounts_ui, "notify::initialized",
+                     G_CALLBACK(accounts_ui_initialized_cb), instance);
+    g_signal_connect(priv->accounts_ui, "plugin-initialized",
+                     G_CALLBACK(accounts_ui_plugin_initialized_cb), instance);
+  }
+}
+
 gboolean
 aui_instance_action_new_account(AuiInstance *instance,
                                 const gchar *service_name,
@@ -574,7 +639,6 @@ aui_instance_action_new_account(AuiInstance *instance,
 {
   AuiInstancePrivate *priv;
   struct auieditdata *data;
-  gboolean initialized = FALSE;
 
   g_return_val_if_fail(AUI_IS_INSTANCE(instance), FALSE);
   g_return_val_if_fail(service_name != NULL, FALSE);
@@ -599,17 +663,7 @@ aui_instance_action_new_account(AuiInstance *instance,
   data->service_name = g_strdup(service_name);
   g_object_set_data_full(G_OBJECT(instance), "auieditdata", data,
                          (GDestroyNotify)auieditdata_destroy);
-  g_object_get(G_OBJECT(priv->accounts_ui),
-               "initialized", &initialized,
-               NULL);
-
-  if (initialized)
-    on_accounts_ui_initialized(instance);
-  else
-  {
-    g_signal_connect(priv->accounts_ui, "notify::initialized",
-                     G_CALLBACK(accounts_ui_initialized_cb), instance);
-  }
+  wait_for_service(instance);
 
   return TRUE;
 }
@@ -622,7 +676,6 @@ aui_instance_action_edit_account(AuiInstance *instance,
 {
   AuiInstancePrivate *priv;
   GStrv parameters;
-  gboolean initialized = FALSE;
 
   g_return_val_if_fail(AUI_IS_INSTANCE(instance), FALSE);
   g_return_val_if_fail(account_name != NULL, FALSE);
@@ -657,17 +710,7 @@ aui_instance_action_edit_account(AuiInstance *instance,
     data->user_name = parameters[2];
     g_object_set_data_full(G_OBJECT(instance), "auieditdata", data,
                            (GDestroyNotify)auieditdata_destroy);
-    g_object_get(G_OBJECT(priv->accounts_ui),
-                 "initialized", &initialized,
-                 NULL);
-
-    if (initialized)
-      on_accounts_ui_initialized(instance);
-    else
-    {
-      g_signal_connect(priv->accounts_ui, "notify::initialized",
-                       G_CALLBACK(accounts_ui_initialized_cb), instance);
-    }
+    wait_for_service(instance);
 
     g_free(parameters);
     return TRUE;
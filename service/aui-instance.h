@@ -59,9 +59,11 @@ struct _AuiInstance
 GType
 aui_instance_get_type(void) G_GNUC_CONST;
 
+/* @accounts_ui can be NULL, a new dialog is created in that case */
 AuiInstance *
 aui_instance_new(DBusGConnection *dbus_gconnection,
-                 guint xid);
+                 guint xid,
+                 GtkWidget *accounts_ui);
 
 const gchar *
 aui_instance_get_object_path(AuiInstance *instance);
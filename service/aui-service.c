@@ -21,6 +21,11 @@
 
 #include <dbus/dbus-glib-lowlevel.h>
 #include <dbus/dbus.h>
+#include <hildon/hildon.h>
+
+#include "accounts-ui-model.h"
+#include "accounts-ui.h"
+#include "rtcom-trace.h"
 
 #include "aui-instance.h"
 
@@ -30,6 +35,17 @@ struct _AuiServicePrivate
 {
   DBusGConnection *dbus_gconnection;
   GList *instances;
+  /* hidden, already initialized dialog handed to the next instance */
+  GtkWidget *standby_ui;
+  guint standby_id;
+  gboolean standby : 1;
+  /* held while in standby, so closing the last instance doesn't tear down
+   * the plugins and the account manager with its dialog */
+  AccountsUIModel *standby_model;
+  /* held between a Prewarm call and the next instance */
+  AccountsUIModel *warm_model;
+  guint prewarm_id;
+  guint warm_timeout_id;
 };
 
 typedef struct _AuiServicePrivate AuiServicePrivate;
@@ -58,6 +74,180 @@ enum
 
 static guint signals[LAST_SIGNAL] = {};
 
+/* how long to keep prewarmed state if no instance is created */
+#define PREWARM_TIMEOUT 30
+
+static void
+standby_ui_destroy_cb(GtkWidget *accounts_ui, AuiService *service)
+{
+  PRIVATE(service)->standby_ui = NULL;
+}
+
+static GtkWidget *
+take_standby_ui(AuiService *service)
+{
+  AuiServicePrivate *priv = PRIVATE(service);
+  GtkWidget *accounts_ui = priv->standby_ui;
+
+  if (accounts_ui)
+  {
+    g_signal_handlers_disconnect_matched(
+      accounts_ui, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+      standby_ui_destroy_cb, service);
+    priv->standby_ui = NULL;
+  }
+
+  return accounts_ui;
+}
+
+static void
+hold_standby_model(AuiService *service)
+{
+  AuiServicePrivate *priv = PRIVATE(service);
+
+  if (priv->standby && !priv->standby_model)
+    priv->standby_model = accounts_ui_model_dup_default();
+}
+
+static gboolean
+create_standby_ui_idle(gpointer user_data)
+{
+  AuiService *service = user_data;
+  AuiServicePrivate *priv = PRIVATE(service);
+
+  priv->standby_id = 0;
+
+  /* plugins are loaded and initialized right away, unless the model is
+   * still alive from the previous instance */
+  hold_standby_model(service);
+
+  if (!priv->standby_ui)
+  {
+    /* the dialog uses the default model, the held one, and is only shown
+     * once an instance takes it over */
+    priv->standby_ui = g_object_new(ACCOUNTS_TYPE_UI, NULL);
+    g_signal_connect(priv->standby_ui, "destroy",
+                     G_CALLBACK(standby_ui_destroy_cb), service);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_standby_ui(AuiService *service)
+{
+  AuiServicePrivate *priv = PRIVATE(service);
+
+  if (priv->standby && !priv->standby_ui && !priv->standby_id)
+  {
+    priv->standby_id = g_idle_add_full(G_PRIORITY_LOW, create_standby_ui_idle,
+                                       service, NULL);
+  }
+}
+
+static void
+release_standby_model(AuiService *service)
+{
+  AuiServicePrivate *priv = PRIVATE(service);
+
+  if (priv->standby_model)
+    g_clear_object(&priv->standby_model);
+}
+
+static void
+release_warm_model(AuiService *service)
+{
+  AuiServicePrivate *priv = PRIVATE(service);
+
+  if (priv->prewarm_id)
+  {
+    g_source_remove(priv->prewarm_id);
+    priv->prewarm_id = 0;
+  }
+
+  if (priv->warm_timeout_id)
+  {
+    g_source_remove(priv->warm_timeout_id);
+    priv->warm_timeout_id = 0;
+  }
+
+  if (priv->warm_model)
+    g_clear_object(&priv->warm_model);
+}
+
+static gboolean
+warm_timeout_cb(gpointer user_data)
+{
+  AuiService *service = user_data;
+
+  PRIVATE(service)->warm_timeout_id = 0;
+  release_warm_model(service);
+  g_signal_emit(service, signals[NUM_INSTANCES_CHANGED], 0);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+prewarm_idle(gpointer user_data)
+{
+  AuiService *service = user_data;
+  AuiServicePrivate *priv = PRIVATE(service);
+
+  priv->prewarm_id = 0;
+
+  /* loads the plugins and starts preparing the account manager and the
+   * services, it is the model later instances get */
+  if (!priv->warm_model)
+    priv->warm_model = accounts_ui_model_dup_default();
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+aui_service_prewarm(AuiService *service)
+{
+  AuiServicePrivate *priv = PRIVATE(service);
+
+  if (!priv->warm_model && !priv->prewarm_id)
+    priv->prewarm_id = g_idle_add(prewarm_idle, service);
+
+  if (priv->warm_timeout_id)
+    g_source_remove(priv->warm_timeout_id);
+
+  priv->warm_timeout_id = g_timeout_add_seconds(PREWARM_TIMEOUT,
+                                                warm_timeout_cb, service);
+  g_signal_emit(service, signals[NUM_INSTANCES_CHANGED], 0);
+}
+
+/* Prewarm is not part of the UI service interface, so it is handled before
+ * dbus-glib dispatches the message. The reply is sent right away, the work
+ * itself starts from idle. */
+static DBusHandlerResult
+prewarm_filter(DBusConnection *connection, DBusMessage *message,
+               void *user_data)
+{
+  DBusMessage *reply;
+
+  if (!dbus_message_is_method_call(message, AUI_SERVICE_PREWARM_INTERFACE,
+                                   "Prewarm") ||
+      g_strcmp0(dbus_message_get_path(message), AUI_SERVICE_DBUS_PATH))
+  {
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  }
+
+  reply = dbus_message_new_method_return(message);
+
+  if (reply)
+  {
+    dbus_connection_send(connection, reply, NULL);
+    dbus_message_unref(reply);
+  }
+
+  aui_service_prewarm(AUI_SERVICE(user_data));
+
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
 static void
 instance_closed_cb(AuiInstance *instance, AuiService *service)
 {
@@ -68,6 +258,9 @@ instance_closed_cb(AuiInstance *instance, AuiService *service)
   g_object_unref(instance);
   priv->instances = g_list_remove(priv->instances, instance);
 
+  if (!priv->instances)
+    schedule_standby_ui(service);
+
   g_signal_emit(service, signals[NUM_INSTANCES_CHANGED], 0);
 }
 
@@ -75,10 +268,16 @@ static AuiInstance *
 create_account_instance(AuiService *service, guint xid, GError **error)
 {
   AuiServicePrivate *priv = PRIVATE(service);
-  AuiInstance *instance = aui_instance_new(priv->dbus_gconnection, xid);
+  AuiInstance *instance = aui_instance_new(priv->dbus_gconnection, xid,
+                                           take_standby_ui(service));
 
   g_return_val_if_fail(instance, NULL);
 
+  /* the instance holds the model now, in standby the service keeps it
+   * past the last instance too */
+  hold_standby_model(service);
+  release_warm_model(service);
+
   g_signal_connect(instance, "closed",
                    G_CALLBACK(instance_closed_cb), service);
   priv->instances = g_list_prepend(priv->instances, instance);
@@ -91,6 +290,7 @@ static gboolean
 aui_service_open_accounts_list(AuiService *self, dbus_uint32_t xid, gchar **ui,
                                GHashTable **ui_properties, GError **error)
 {
+  gint64 begin = rtcom_trace_begin();
   AuiInstance *instance = create_account_instance(self, xid, error);
 
   if (!instance)
@@ -106,6 +306,7 @@ aui_service_open_accounts_list(AuiService *self, dbus_uint32_t xid, gchar **ui,
 
   *ui = g_strdup(aui_instance_get_object_path(instance));
   *ui_properties = aui_instance_get_properties(instance);
+  rtcom_trace_end(begin, "OpenAccountsList", NULL);
 
   return TRUE;
 }
@@ -115,7 +316,10 @@ aui_service_new_account(AuiService *service, guint xid, const gchar *svc_name,
                         const gchar *on_finish, DBusGMethodInvocation *ctx)
 {
   GError *error = NULL;
-  AuiInstance *instance = create_account_instance(service, xid, &error);
+  AuiInstance *instance;
+
+  rtcom_trace_mark("NewAccount", svc_name);
+  instance = create_account_instance(service, xid, &error);
 
   if (instance)
   {
@@ -134,7 +338,10 @@ aui_service_edit_account(AuiService *service, guint xid, gchar *acct_name,
                          gchar *on_finish, DBusGMethodInvocation *ctx)
 {
   GError *error = NULL;
-  AuiInstance *instance = create_account_instance(service, xid, &error);
+  AuiInstance *instance;
+
+  rtcom_trace_mark("EditAccount", acct_name);
+  instance = create_account_instance(service, xid, &error);
 
   if (instance)
   {
@@ -182,6 +389,7 @@ constructor(GType type, guint n_construct_properties,
 
     dbus_g_connection_register_g_object(priv->dbus_gconnection,
                                         AUI_SERVICE_DBUS_PATH, service);
+    dbus_connection_add_filter(dbus, prewarm_filter, service, NULL);
   }
   else
   {
@@ -197,6 +405,10 @@ dispose(GObject *object)
 {
   AuiServicePrivate *priv = PRIVATE(object);
 
+  aui_service_drop_standby(AUI_SERVICE(object));
+  release_standby_model(AUI_SERVICE(object));
+  release_warm_model(AUI_SERVICE(object));
+
   while (priv->instances)
   {
     g_object_unref(priv->instances->data);
@@ -205,6 +417,9 @@ dispose(GObject *object)
 
   if (priv->dbus_gconnection)
   {
+    dbus_connection_remove_filter(
+      dbus_g_connection_get_connection(priv->dbus_gconnection),
+      prewarm_filter, object);
     dbus_g_connection_unref(priv->dbus_gconnection);
     priv->dbus_gconnection = NULL;
   }
@@ -281,3 +496,67 @@ aui_service_has_instances(AuiService *service)
 
   return !!PRIVATE(service)->instances;
 }
+
+void
+aui_service_set_standby(AuiService *service, gboolean standby)
+{
+  AuiServicePrivate *priv;
+
+  g_return_if_fail(AUI_IS_SERVICE(service));
+
+  priv = PRIVATE(service);
+  priv->standby = standby;
+
+  if (!standby)
+  {
+    aui_service_drop_standby(service);
+    /* e.g. on memory pressure, open instances keep their own reference */
+    release_standby_model(service);
+  }
+  else if (!priv->instances)
+    schedule_standby_ui(service);
+  else
+    hold_standby_model(service);
+}
+
+gboolean
+aui_service_is_warm(AuiService *service)
+{
+  AuiServicePrivate *priv;
+
+  g_return_val_if_fail(AUI_IS_SERVICE(service), FALSE);
+
+  priv = PRIVATE(service);
+
+  return priv->warm_model || priv->prewarm_id;
+}
+
+gboolean
+aui_service_get_standby(AuiService *service)
+{
+  g_return_val_if_fail(AUI_IS_SERVICE(service), FALSE);
+
+  return PRIVATE(service)->standby;
+}
+
+void
+aui_service_drop_standby(AuiService *service)
+{
+  AuiServicePrivate *priv;
+  GtkWidget *accounts_ui;
+
+  g_return_if_fail(AUI_IS_SERVICE(service));
+
+  priv = PRIVATE(service);
+
+  if (priv->standby_id)
+  {
+    g_source_remove(priv->standby_id);
+    priv->standby_id = 0;
+  }
+
+  accounts_ui = take_standby_ui(service);
+
+  if (accounts_ui)
+    gtk_widget_destroy(accounts_ui);
+}
@@ -62,11 +62,30 @@ aui_service_get_type(void) G_GNUC_CONST;
 gboolean
 aui_service_has_instances(AuiService *service);
 
+/* Whether a Prewarm call is still waiting for an instance to be created */
+gboolean
+aui_service_is_warm(AuiService *service);
+
 AuiService *
 aui_service_new(DBusGConnection *dbus_gconnection);
 
+/* In standby mode the service keeps the accounts model and an initialized
+ * accounts dialog around while there are no instances, so the next one opens
+ * without delay */
+void
+aui_service_set_standby(AuiService *service, gboolean standby);
+
+gboolean
+aui_service_get_standby(AuiService *service);
+
+/* Frees the standby dialog, e.g. on memory pressure. It is not recreated
+ * until the last instance is closed again. */
+void
+aui_service_drop_standby(AuiService *service);
+
 #define AUI_SERVICE_DBUS_NAME "com.nokia.AccountsUI"
 #define AUI_SERVICE_DBUS_PATH "/com/nokia/AccountsUI"
+#define AUI_SERVICE_PREWARM_INTERFACE "com.nokia.Accounts.UI.Prewarm"
 
 G_END_DECLS
 
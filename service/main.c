@@ -24,13 +24,26 @@
 #include <libosso.h>
 
 #include "aui-service.h"
+#include "rtcom-trace.h"
+
+static gboolean standby = FALSE;
+
+static GOptionEntry entries[] =
+{
+  {
+    "standby", 0, 0, G_OPTION_ARG_NONE, &standby,
+    "Stay in memory with an initialized accounts dialog when idle", NULL
+  },
+  { NULL }
+};
 
 static void
 aui_service_num_instances_changed_cb(AuiService *service)
 {
   static guint timeout_id = 0;
 
-  if (aui_service_has_instances(service))
+  if (aui_service_has_instances(service) ||
+      aui_service_get_standby(service) || aui_service_is_warm(service))
   {
     if (timeout_id)
     {
@@ -38,10 +51,54 @@ aui_service_num_instances_changed_cb(AuiService *service)
       timeout_id = 0;
     }
   }
-  else
+  else if (!timeout_id)
     timeout_id = g_timeout_add_seconds(5, (GSourceFunc)gtk_main_quit, NULL);
 }
 
+static void
+hw_event_cb(osso_hw_state_t *state, gpointer user_data)
+{
+  AuiService *service = user_data;
+
+  if (state->memory_low_ind)
+  {
+    /* leave standby until memory is available again, quitting is the
+     * cheapest way to give everything back if nothing is open */
+    aui_service_set_standby(service, FALSE);
+    aui_service_num_instances_changed_cb(service);
+  }
+  else if (standby && !aui_service_get_standby(service))
+  {
+    aui_service_set_standby(service, TRUE);
+    aui_service_num_instances_changed_cb(service);
+  }
+}
+
+static gboolean
+parse_options(int *argc, char ***argv)
+{
+  GOptionContext *context = g_option_context_new(NULL);
+  GError *error = NULL;
+  gboolean rv;
+
+  if (g_getenv("RTCOM_ACCOUNTS_UI_STANDBY"))
+    standby = TRUE;
+
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_set_ignore_unknown_options(context, TRUE);
+  rv = g_option_context_parse(context, argc, argv, &error);
+
+  if (!rv)
+  {
+    g_warning("Failed to parse options: %s", error->message);
+    g_error_free(error);
+  }
+
+  g_option_context_free(context);
+
+  return rv;
+}
+
 int
 main(int argc, char **argv, char **envp)
 {
@@ -51,9 +108,11 @@ main(int argc, char **argv, char **envp)
   AuiService *service;
   GError *error = NULL;
 
-#if !GLIB_CHECK_VERSION(2, 32, 0)
-  g_thread_init(NULL);
-#endif
+  if (!parse_options(&argc, &argv))
+    exit(1);
+
+  rtcom_trace_mark("service-start", NULL);
+
   g_set_application_name("");
   osso = osso_initialize("RtcomAccounts", "1.0", FALSE, NULL);
 
@@ -72,9 +131,15 @@ main(int argc, char **argv, char **envp)
 
     if (service)
     {
+      osso_hw_state_t hw_state = { 0 };
+
+      hw_state.memory_low_ind = TRUE;
+      osso_hw_set_event_cb(osso, &hw_state, hw_event_cb, service);
+      aui_service_set_standby(service, standby);
       g_signal_connect(service, "num-instances-changed",
                        G_CALLBACK(aui_service_num_instances_changed_cb), NULL);
       gtk_main();
+      osso_hw_unset_event_cb(osso, &hw_state);
       g_object_unref(service);
     }
     else
@@ -23,6 +23,7 @@
 #include <telepathy-glib/telepathy-glib.h>
 
 #include "rtcom-account-marshal.h"
+#include "rtcom-avatar-cache.h"
 
 #include "rtcom-account-item.h"
 
@@ -57,32 +58,40 @@ enum
   ENABLED_SET = 0x10
 };
 
-static GdkPixbuf *
-avatar_to_pixbuf(const guchar *data, gsize len, const char *mime_type)
+static void
+cancel_avatar_decode(RtcomAccountItem *item)
 {
-  GdkPixbufLoader *loader;
-  GdkPixbuf *pixbuf;
-
-  if (!data || !mime_type || !*mime_type)
-    return NULL;
-
-  loader = gdk_pixbuf_loader_new_with_mime_type(mime_type, NULL);
+  if (item->avatar_cancellable)
+  {
+    g_cancellable_cancel(item->avatar_cancellable);
+    g_object_unref(item->avatar_cancellable);
+    item->avatar_cancellable = NULL;
+  }
+}
 
-  if (!loader)
-    return NULL;
+static void
+avatar_decoded_cb(GObject *source_object, GAsyncResult *res,
+                  gpointer user_data)
+{
+  RtcomAccountItem *item = user_data;
+  GError *error = NULL;
+  GdkPixbuf *pixbuf = rtcom_avatar_cache_get_pixbuf_finish(res, &error);
 
-  gdk_pixbuf_loader_set_size(loader, HILDON_ICON_SIZE_FINGER,
-                             HILDON_ICON_SIZE_FINGER);
-  gdk_pixbuf_loader_write(loader, data, len, NULL);
-  gdk_pixbuf_loader_close(loader, NULL);
-  pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+  /* cancelled on dispose too, so @item must not be touched */
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+  {
+    g_error_free(error);
+    return;
+  }
 
-  if (pixbuf)
-    g_object_ref(pixbuf);
+  g_clear_error(&error);
+  g_clear_object(&item->avatar_cancellable);
 
-  g_object_unref(loader);
+  if (ACCOUNT_ITEM(item)->avatar)
+    g_object_unref(ACCOUNT_ITEM(item)->avatar);
 
-  return pixbuf;
+  ACCOUNT_ITEM(item)->avatar = pixbuf;
+  g_object_notify(G_OBJECT(item), "avatar");
 }
 
 static void
@@ -102,7 +111,7 @@ get_avatar_ready_cb(TpProxy *proxy, const GValue *out_Value,
   }
   else
   {
-    AccountItem *item = ACCOUNT_ITEM(weak_object);
+    RtcomAccountItem *item = RTCOM_ACCOUNT_ITEM(weak_object);
     GValueArray *array;
     const GArray *avatar;
     const gchar *mime_type;
@@ -110,19 +119,25 @@ get_avatar_ready_cb(TpProxy *proxy, const GValue *out_Value,
     array = g_value_get_boxed(out_Value);
     tp_value_array_unpack(array, 2, &avatar, &mime_type);
 
-    if (item->avatar)
+    cancel_avatar_decode(item);
+
+    if (avatar && avatar->len && mime_type && *mime_type)
     {
-      g_object_unref(item->avatar);
-      item->avatar = NULL;
+      GBytes *data = g_bytes_new(avatar->data, avatar->len);
+
+      /* decoded in a worker thread, the old avatar is shown meanwhile */
+      item->avatar_cancellable = g_cancellable_new();
+      rtcom_avatar_cache_get_pixbuf_async(
+        data, mime_type, HILDON_ICON_SIZE_FINGER, HILDON_ICON_SIZE_FINGER,
+        item->avatar_cancellable, avatar_decoded_cb, item);
+      g_bytes_unref(data);
     }
-
-    if (avatar)
+    else if (ACCOUNT_ITEM(item)->avatar)
     {
-      item->avatar =
-        avatar_to_pixbuf((guchar *)avatar->data, avatar->len, mime_type);
+      g_object_unref(ACCOUNT_ITEM(item)->avatar);
+      ACCOUNT_ITEM(item)->avatar = NULL;
+      g_object_notify(G_OBJECT(item), "avatar");
     }
-
-    g_object_notify(G_OBJECT(item), "avatar");
   }
 }
 
@@ -253,6 +268,7 @@ tp_account_unref(RtcomAccountItem *item)
 static void
 rtcom_account_item_dispose(GObject *object)
 {
+  cancel_avatar_decode(RTCOM_ACCOUNT_ITEM(object));
   tp_account_unref(RTCOM_ACCOUNT_ITEM(object));
 
   G_OBJECT_CLASS(rtcom_account_item_parent_class)->dispose(object);
@@ -264,8 +280,14 @@ free_store_data(RtcomAccountItem *item)
   if (item->new_params)
     g_hash_table_remove_all(item->new_params);
 
-  g_free(item->avatar_data);
-  item->avatar_data = NULL;
+  if (item->dirty_params)
+    g_hash_table_remove_all(item->dirty_params);
+
+  if (item->avatar_bytes)
+  {
+    g_bytes_unref(item->avatar_bytes);
+    item->avatar_bytes = NULL;
+  }
 
   g_free(item->avatar_mime);
   item->avatar_mime = NULL;
@@ -287,6 +309,7 @@ rtcom_account_item_finalize(GObject *object)
 
   free_store_data(item);
   g_hash_table_destroy(item->new_params);
+  g_hash_table_destroy(item->dirty_params);
 
   G_OBJECT_CLASS(rtcom_account_item_parent_class)->finalize(object);
 }
@@ -298,6 +321,9 @@ update_account_item(AccountItem *item, TpAccount *account)
   gboolean bval;
   const gchar *display_name;
 
+  /* listeners get all the changes at once */
+  g_object_freeze_notify(G_OBJECT(item));
+
   v = g_hash_table_lookup((GHashTable *)tp_account_get_parameters(account),
                           "account");
 
@@ -354,6 +380,8 @@ update_account_item(AccountItem *item, TpAccount *account)
       account, -1, TP_IFACE_ACCOUNT_INTERFACE_AVATAR, "Avatar",
       get_avatar_ready_cb, NULL, NULL, G_OBJECT(item));
   }
+
+  g_object_thaw_notify(G_OBJECT(item));
 }
 
 static void
@@ -549,6 +577,11 @@ rtcom_account_item_init(RtcomAccountItem *item)
       (GEqualFunc)&g_str_equal,
       (GDestroyNotify)&g_free,
       (GDestroyNotify)g_value_free);
+  item->dirty_params = g_hash_table_new_full(
+      (GHashFunc)&g_str_hash,
+      (GEqualFunc)&g_str_equal,
+      (GDestroyNotify)&g_free,
+      NULL);
 }
 
 RtcomAccountItem *
@@ -573,8 +606,11 @@ rtcom_account_item_verify_parameter(RtcomAccountItem *item, const gchar *name)
 {
   AccountService *service = account_item_get_service(ACCOUNT_ITEM(item));
 
-  if (tp_protocol_has_param(RTCOM_ACCOUNT_SERVICE(service)->protocol, name))
+  if (rtcom_account_service_get_param_schema(RTCOM_ACCOUNT_SERVICE(service),
+                                             name))
+  {
     return TRUE;
+  }
 
   g_warning("Parameter %s is not supported by service %s", name,
             service->name);
@@ -582,6 +618,83 @@ rtcom_account_item_verify_parameter(RtcomAccountItem *item, const gchar *name)
   return FALSE;
 }
 
+static gboolean
+param_equal(const GValue *val1, const GValue *val2)
+{
+  if (G_VALUE_TYPE(val2) != G_VALUE_TYPE(val1))
+    return FALSE;
+
+  switch (G_VALUE_TYPE(val2))
+  {
+    case G_TYPE_CHAR:
+    {
+      return g_value_get_schar(val2) == g_value_get_schar(val1);
+    }
+    case G_TYPE_UCHAR:
+    {
+      return g_value_get_uchar(val2) == g_value_get_uchar(val1);
+    }
+    case G_TYPE_BOOLEAN:
+    {
+      return g_value_get_boolean(val2) == g_value_get_boolean(val1);
+    }
+    case G_TYPE_INT:
+    {
+      return g_value_get_int(val2) == g_value_get_int(val1);
+    }
+    case G_TYPE_UINT:
+    {
+      return g_value_get_uint(val2) == g_value_get_uint(val1);
+    }
+    case G_TYPE_LONG:
+    {
+      return g_value_get_long(val2) == g_value_get_long(val1);
+    }
+    case G_TYPE_ULONG:
+    {
+      return g_value_get_ulong(val2) == g_value_get_ulong(val1);
+    }
+    case G_TYPE_INT64:
+    {
+      return g_value_get_int64(val2) == g_value_get_int64(val1);
+    }
+    case G_TYPE_UINT64:
+    {
+      return g_value_get_uint64(val2) == g_value_get_uint64(val1);
+    }
+    case G_TYPE_STRING:
+    {
+      return !g_strcmp0(g_value_get_string(val2), g_value_get_string(val1));
+    }
+    default:
+      return FALSE;
+  }
+}
+
+/* Takes @v. The parameters of the TpAccount are the ones last loaded, so
+ * only the parameters that differ from those have to be sent on save. */
+static void
+store_param(RtcomAccountItem *item, const gchar *name, GValue *v)
+{
+  const GValue *old = NULL;
+
+  if (item->account)
+  {
+    GHashTable *params =
+      (GHashTable *)tp_account_get_parameters(item->account);
+
+    if (params)
+      old = g_hash_table_lookup(params, name);
+  }
+
+  if (old && param_equal(old, v))
+    g_hash_table_remove(item->dirty_params, name);
+  else
+    g_hash_table_insert(item->dirty_params, g_strdup(name), NULL);
+
+  g_hash_table_insert(item->new_params, g_strdup(name), v);
+}
+
 void
 rtcom_account_item_store_param_boolean(RtcomAccountItem *item,
                                        const gchar *name, gboolean value)
@@ -594,7 +707,7 @@ rtcom_account_item_store_param_boolean(RtcomAccountItem *item,
   v = g_new0(GValue, 1);
   g_value_init(v, G_TYPE_BOOLEAN);
   g_value_set_boolean(v, value);
-  g_hash_table_insert(item->new_params, g_strdup(name), v);
+  store_param(item, name, v);
 }
 
 void
@@ -609,7 +722,7 @@ rtcom_account_item_store_param_uint(RtcomAccountItem *item, const gchar *name,
   v = g_new0(GValue, 1);
   g_value_init(v, G_TYPE_UINT);
   g_value_set_uint(v, value);
-  g_hash_table_insert(item->new_params, g_strdup(name), v);
+  store_param(item, name, v);
 }
 
 void
@@ -624,7 +737,7 @@ rtcom_account_item_store_param_int(RtcomAccountItem *item, const gchar *name,
   v = g_new0(GValue, 1);
   g_value_init(v, G_TYPE_INT);
   g_value_set_int(v, value);
-  g_hash_table_insert(item->new_params, g_strdup(name), v);
+  store_param(item, name, v);
 }
 
 void
@@ -640,7 +753,7 @@ rtcom_account_item_store_param_string(RtcomAccountItem *item, const gchar *name,
   g_value_init(v, G_TYPE_STRING);
   g_value_set_string(v, value);
 
-  g_hash_table_insert(item->new_params, g_strdup(name), v);
+  store_param(item, name, v);
 }
 
 void
@@ -661,12 +774,56 @@ void
 rtcom_account_item_store_avatar(RtcomAccountItem *item, gchar *data, gsize len,
                                 const gchar *mime_type)
 {
-  item->avatar_data = data;
-  item->avatar_len = len;
+  GBytes *bytes = g_bytes_new_take(data, len);
+
+  rtcom_account_item_store_avatar_bytes(item, bytes, mime_type);
+  g_bytes_unref(bytes);
+}
+
+void
+rtcom_account_item_store_avatar_bytes(RtcomAccountItem *item, GBytes *data,
+                                      const gchar *mime_type)
+{
+  if (item->avatar_bytes)
+    g_bytes_unref(item->avatar_bytes);
+
+  g_free(item->avatar_mime);
+
+  item->avatar_bytes = g_bytes_ref(data);
   item->set_mask |= AVATAR_SET;
   item->avatar_mime = g_strdup(mime_type);
 }
 
+/* Builds the Telepathy avatar struct from the stored avatar, which is
+ * released. The data is copied once, straight into an array of the size
+ * needed. */
+static GValueArray *
+take_avatar_struct(RtcomAccountItem *item)
+{
+  GValueArray *arr = g_value_array_new(2);
+  gsize len;
+  gconstpointer bytes = g_bytes_get_data(item->avatar_bytes, &len);
+  GArray *data = g_array_sized_new(FALSE, FALSE, sizeof(guchar), len);
+  GValue *v;
+
+  g_array_append_vals(data, bytes, len);
+  g_bytes_unref(item->avatar_bytes);
+  item->avatar_bytes = NULL;
+
+  /* appending a NULL value avoids copying the array into the struct */
+  g_value_array_append(arr, NULL);
+  v = g_value_array_get_nth(arr, 0);
+  g_value_init(v, TP_TYPE_UCHAR_ARRAY);
+  g_value_take_boxed(v, data);
+
+  g_value_array_append(arr, NULL);
+  v = g_value_array_get_nth(arr, 1);
+  g_value_init(v, G_TYPE_STRING);
+  g_value_set_string(v, item->avatar_mime);
+
+  return arr;
+}
+
 void
 rtcom_account_item_store_secondary_vcard_fields(RtcomAccountItem *item,
                                                 GList *fields)
@@ -695,33 +852,23 @@ void
 rtcom_account_item_unset_param(RtcomAccountItem *item, const gchar *name)
 {
   g_hash_table_remove(item->new_params, name);
+  g_hash_table_remove(item->dirty_params, name);
 }
 
 gboolean
 rtcom_account_item_store_settings(RtcomAccountItem *item, GError **error)
 {
-  TpProtocol *protocol = rtcom_account_item_get_tp_protocol(item);
+  AccountService *service = account_item_get_service(ACCOUNT_ITEM(item));
+  const RtcomParamSchema *server;
   gboolean result;
 
-  if (protocol && tp_protocol_has_param(protocol, "server"))
-  {
-    const TpConnectionManagerParam *server;
-
-    server = tp_protocol_get_param(protocol, "server");
-
-    if (server)
-    {
-      GValue v = G_VALUE_INIT;
-
-      if (tp_connection_manager_param_get_default(server, &v) &&
-          G_VALUE_HOLDS_STRING(&v))
-      {
-        rtcom_account_item_store_param_string(item,
-                                              "server", g_value_get_string(&v));
-      }
-    }
+  server = rtcom_account_service_get_param_schema(
+      RTCOM_ACCOUNT_SERVICE(service), "server");
 
-    g_object_unref(protocol);
+  if (server && G_VALUE_HOLDS_STRING(&server->default_value))
+  {
+    rtcom_account_item_store_param_string(
+      item, "server", g_value_get_string(&server->default_value));
   }
 
   item->set_mask = 0;
@@ -979,19 +1126,12 @@ create_account(RtcomAccountItem *item)
                              item->nickname);
   }
 
-  if (item->set_mask & AVATAR_SET)
+  /* a new account has no avatar to clear */
+  if ((item->set_mask & AVATAR_SET) && item->avatar_bytes &&
+      g_bytes_get_size(item->avatar_bytes))
   {
-    GArray *data = g_array_new(FALSE, FALSE, sizeof(guchar));
-    GValueArray *arr;
-
-    g_array_append_vals(data, item->avatar_data, item->avatar_len);
-    arr = tp_value_array_build(2,
-                               TP_TYPE_UCHAR_ARRAY, data,
-                               G_TYPE_STRING, item->avatar_mime,
-                               G_TYPE_INVALID);
-    g_array_unref(data);
     tp_asv_take_boxed(properties, TP_PROP_ACCOUNT_INTERFACE_AVATAR_AVATAR,
-                      TP_STRUCT_TYPE_AVATAR, arr);
+                      TP_STRUCT_TYPE_AVATAR, take_avatar_struct(item));
   }
 
   display_name = item->display_name;
@@ -1022,107 +1162,152 @@ create_account(RtcomAccountItem *item)
   g_object_unref(protocol);
 }
 
-static void
-check_param_removed(gpointer key, gpointer value, gpointer user_data)
+/* All the writes of a save are sent at once, "updated" is emitted when the
+ * last of them completes */
+typedef struct
 {
-  const GValue *val1 = value;
-  gpointer *data = user_data;
-  GHashTable *new_params = data[0];
-  gchar **unset = data[1];
-  const GValue *val2 = g_hash_table_lookup(new_params, key);
-  gboolean remove;
+  RtcomAccountItem *item;
+  guint pending;
+  gboolean reconnect;
+} save_data;
 
-  if (!val2)
-  {
-    gchar **p = unset;
+typedef gboolean (*save_finish_func)(TpAccount *, GAsyncResult *, GError **);
 
-    while (*p)
-      p++;
+typedef struct
+{
+  save_data *data;
+  save_finish_func finish;
+  const gchar *what;
+} save_op;
 
-    *p = g_strdup(key);
+static void
+save_data_release(save_data *data)
+{
+  if (--data->pending)
     return;
-  }
 
-  g_return_if_fail(val1 != NULL);
+  g_signal_emit(data->item, signals[UPDATED], 0, data->reconnect);
+  g_object_unref(data->item);
+  g_slice_free(save_data, data);
+}
 
-  if (G_VALUE_TYPE(val2) != G_VALUE_TYPE(val1))
-    return;
+static gboolean
+save_data_release_idle(gpointer user_data)
+{
+  save_data_release(user_data);
 
-  switch (G_VALUE_TYPE(val2))
+  return G_SOURCE_REMOVE;
+}
+
+static void
+save_op_cb(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  save_op *op = user_data;
+  GError *error = NULL;
+
+  if (!op->finish(TP_ACCOUNT(source_object), res, &error))
   {
-    case G_TYPE_CHAR:
-    {
-      remove = g_value_get_schar(val2) == g_value_get_schar(val1);
-      break;
-    }
-    case G_TYPE_UCHAR:
-    {
-      remove = g_value_get_uchar(val2) == g_value_get_uchar(val1);
-      break;
-    }
-    case G_TYPE_BOOLEAN:
-    {
-      remove = g_value_get_boolean(val2) == g_value_get_boolean(val1);
-      break;
-    }
-    case G_TYPE_INT:
-    {
-      remove = g_value_get_int(val2) == g_value_get_int(val1);
-      break;
-    }
-    case G_TYPE_UINT:
-    {
-      remove = g_value_get_uint(val2) == g_value_get_uint(val1);
-      break;
-    }
-    case G_TYPE_LONG:
-    {
-      remove = g_value_get_long(val2) == g_value_get_long(val1);
-      break;
-    }
-    case G_TYPE_ULONG:
-    {
-      remove = g_value_get_ulong(val2) == g_value_get_ulong(val1);
-      break;
-    }
-    case G_TYPE_INT64:
-    {
-      remove = g_value_get_int64(val2) == g_value_get_int64(val1);
-      break;
-    }
-    case G_TYPE_UINT64:
-    {
-      remove = g_value_get_uint64(val2) == g_value_get_uint64(val1);
-      break;
-    }
-    case G_TYPE_STRING:
-    {
-      remove = !g_strcmp0(g_value_get_string(val2), g_value_get_string(val1));
-      break;
-    }
-    default:
-      return;
+    g_warning("%s: Error setting %s: %s", __FUNCTION__, op->what,
+              error ? error->message : "unknown error");
+    g_clear_error(&error);
   }
 
-  if (remove)
-    g_hash_table_remove(new_params, key);
+  save_data_release(op->data);
+  g_slice_free(save_op, op);
+}
+
+static save_op *
+save_op_new(save_data *data, save_finish_func finish, const gchar *what)
+{
+  save_op *op = g_slice_new(save_op);
+
+  op->data = data;
+  op->finish = finish;
+  op->what = what;
+  data->pending++;
+
+  return op;
 }
 
 static void
 update_parameters_cb(GObject *source_object, GAsyncResult *res,
                      gpointer user_data)
 {
-  RtcomAccountItem *item = user_data;
-  TpAccount *account = TP_ACCOUNT(source_object);
-  gchar **reconnect_required;
+  save_data *data = user_data;
+  gchar **reconnect_required = NULL;
   GError *error = NULL;
-  gboolean success = tp_account_update_parameters_finish(
-      account, res, &reconnect_required, &error);
 
-  if (!success || error || !reconnect_required)
-    g_signal_emit(item, signals[UPDATED], 0, FALSE);
+  if (tp_account_update_parameters_finish(
+        TP_ACCOUNT(source_object), res, &reconnect_required, &error))
+  {
+    if (reconnect_required && *reconnect_required)
+      data->reconnect = TRUE;
+  }
   else
-    g_signal_emit(item, signals[UPDATED], 0, *reconnect_required);
+  {
+    g_warning("%s: Error updating parameters: %s", __FUNCTION__,
+              error ? error->message : "unknown error");
+    g_clear_error(&error);
+  }
+
+  g_strfreev(reconnect_required);
+  save_data_release(data);
+}
+
+static void
+set_avatar_cb(TpProxy *proxy, const GError *error, gpointer user_data,
+              GObject *weak_object)
+{
+  if (error)
+    g_warning("%s: Error setting avatar: %s", __FUNCTION__, error->message);
+
+  save_data_release(user_data);
+}
+
+static void
+save_parameters(RtcomAccountItem *item, save_data *data)
+{
+  GHashTable *params;
+  GHashTable *changed;
+  GPtrArray *unset = g_ptr_array_new();
+  GHashTableIter iter;
+  gpointer name;
+
+  changed = g_hash_table_new((GHashFunc)&g_str_hash,
+                             (GEqualFunc)&g_str_equal);
+  g_hash_table_iter_init(&iter, item->dirty_params);
+
+  while (g_hash_table_iter_next(&iter, &name, NULL))
+  {
+    g_hash_table_insert(changed, name,
+                        g_hash_table_lookup(item->new_params, name));
+  }
+
+  params = (GHashTable *)tp_account_get_parameters(item->account);
+
+  /* parameters that were not stored again are unset */
+  if (params)
+  {
+    g_hash_table_iter_init(&iter, params);
+
+    while (g_hash_table_iter_next(&iter, &name, NULL))
+    {
+      if (!g_hash_table_lookup(item->new_params, name))
+        g_ptr_array_add(unset, name);
+    }
+  }
+
+  if (g_hash_table_size(changed) || unset->len)
+  {
+    g_ptr_array_add(unset, NULL);
+    data->pending++;
+    tp_account_update_parameters_async(
+      item->account, changed, (const gchar **)unset->pdata,
+      update_parameters_cb, data);
+  }
+
+  g_ptr_array_free(unset, TRUE);
+  g_hash_table_destroy(changed);
 }
 
 void
@@ -1130,58 +1315,82 @@ rtcom_account_item_save_settings(RtcomAccountItem *item, GError **error)
 {
   if (item->account)
   {
-    GHashTable *params;
-    gchar **unset = NULL;
+    TpAccount *account = item->account;
+    save_data *data = g_slice_new(save_data);
 
     g_object_set_data_full(
       G_OBJECT(item), "user-id",
       g_value_dup_string(g_hash_table_lookup(item->new_params, "account")),
       (GDestroyNotify)&g_free);
 
-    params = (GHashTable *)tp_account_get_parameters(item->account);
-
-    if (params)
-    {
-      gpointer data[2];
-
-      unset = g_new0(gchar *, g_hash_table_size(params) + 1);
-
-      data[0] = item->new_params;
-      data[1] = unset;
-      g_hash_table_foreach(params, check_param_removed, data);
-    }
+    /* the initial count keeps the save pending until all is dispatched */
+    data->item = g_object_ref(item);
+    data->pending = 1;
+    data->reconnect = FALSE;
 
-    tp_account_update_parameters_async(
-      item->account, item->new_params, (const gchar **)unset,
-      update_parameters_cb, item);
+    save_parameters(item, data);
 
-    g_strfreev(unset);
-
-    if (item->set_mask & DISPLAY_NAME_SET)
+    /* properties that already have the requested value are not set */
+    if ((item->set_mask & DISPLAY_NAME_SET) &&
+        g_strcmp0(item->display_name, tp_account_get_display_name(account)))
     {
       tp_account_set_display_name_async(
-        item->account, item->display_name, NULL, NULL);
+        account, item->display_name, save_op_cb,
+        save_op_new(data, tp_account_set_display_name_finish,
+                    "display name"));
     }
 
-    if (item->set_mask & NICKNAME_SET)
-      tp_account_set_nickname_async(item->account, item->nickname, NULL, NULL);
+    if ((item->set_mask & NICKNAME_SET) &&
+        g_strcmp0(item->nickname, tp_account_get_nickname(account)))
+    {
+      tp_account_set_nickname_async(
+        account, item->nickname, save_op_cb,
+        save_op_new(data, tp_account_set_nickname_finish, "nickname"));
+    }
 
-    if (item->set_mask & AVATAR_SET)
+    if ((item->set_mask & AVATAR_SET) && item->avatar_bytes)
     {
-      tp_account_set_avatar_async(item->account, (guchar *)item->avatar_data,
-                                  item->avatar_len, item->avatar_mime,
-                                  NULL, NULL);
+      GValue value = G_VALUE_INIT;
+
+      g_value_init(&value, TP_STRUCT_TYPE_AVATAR);
+      g_value_take_boxed(&value, take_avatar_struct(item));
+      data->pending++;
+      tp_cli_dbus_properties_call_set(
+        account, -1, TP_IFACE_ACCOUNT_INTERFACE_AVATAR, "Avatar", &value,
+        set_avatar_cb, data, NULL, NULL);
+      g_value_unset(&value);
     }
 
-    if (item->set_mask & SVCF_SET)
-      set_uri_schemes(item);
+    if ((item->set_mask & SVCF_SET) && item->secondary_vcard_fields)
+    {
+      gchar **scheme;
 
-    if (item->set_mask & ENABLED_SET)
+      for (scheme = item->secondary_vcard_fields; *scheme; scheme++)
+      {
+        if (!tp_account_associated_with_uri_scheme(account, *scheme))
+        {
+          tp_account_set_uri_scheme_association_async(
+            account, *scheme, TRUE, save_op_cb,
+            save_op_new(data, tp_account_set_uri_scheme_association_finish,
+                        "URI scheme association"));
+        }
+      }
+    }
+
+    if ((item->set_mask & ENABLED_SET) &&
+        !item->enabled_setting != !tp_account_is_enabled(account))
     {
       tp_account_set_enabled_async(
-        item->account, item->enabled_setting, NULL, NULL);
+        account, item->enabled_setting, save_op_cb,
+        save_op_new(data, tp_account_set_enabled_finish, "enabled"));
     }
 
+    /* nothing was sent, still complete the save asynchronously */
+    if (data->pending == 1)
+      g_idle_add(save_data_release_idle, data);
+    else
+      save_data_release(data);
+
     free_store_data(item);
   }
   else
@@ -54,11 +54,17 @@ struct _RtcomAccountItem
     GHashTable *new_params;
     gchar *display_name;
     gchar *nickname;
-    gchar *avatar_data;
-    gsize avatar_len;
+    /* unused, keeps the layout of older releases */
+    gpointer padding[2];
     gchar *avatar_mime;
     gchar **secondary_vcard_fields;
     gboolean enabled_setting;
+    /* names of the stored parameters that differ from the account ones */
+    GHashTable *dirty_params;
+    /* pending avatar decode */
+    GCancellable *avatar_cancellable;
+    /* encoded avatar to be saved */
+    GBytes *avatar_bytes;
 };
 
 GType rtcom_account_item_get_type (void) G_GNUC_CONST;
@@ -85,6 +91,9 @@ void rtcom_account_item_store_nickname (RtcomAccountItem *item,
 void rtcom_account_item_store_avatar (RtcomAccountItem *item,
                                       gchar *data, gsize len,
                                       const gchar *mime_type);
+void rtcom_account_item_store_avatar_bytes (RtcomAccountItem *item,
+                                            GBytes *data,
+                                            const gchar *mime_type);
 void rtcom_account_item_store_secondary_vcard_fields (RtcomAccountItem *item,
                                                       GList *fields);
 void rtcom_account_item_unset_param (RtcomAccountItem *item,
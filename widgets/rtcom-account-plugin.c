@@ -24,13 +24,16 @@
 #include <telepathy-glib/simple-client-factory.h>
 
 #include "rtcom-account-plugin.h"
+#include "rtcom-trace.h"
 
 struct _RtcomAccountPluginPrivate
 {
   gboolean initialized;
-  gulong account_validity_changed_id;
-  gulong account_removed_id;
   GList *pending_services;
+  /* key is TpAccount path suffix, value is RtcomAccountItem */
+  GHashTable *accounts;
+  /* start of the "account-manager-prepare" trace span */
+  gint64 manager_prepare_begin;
 };
 
 typedef struct _RtcomAccountPluginPrivate RtcomAccountPluginPrivate;
@@ -50,55 +53,107 @@ enum
   PROP_INITIALIZED = 1
 };
 
+/* Identifies a service by the quarks of the parts of its id, so the service
+ * of an account can be looked up without building the id */
+typedef struct
+{
+  GQuark cm;
+  GQuark protocol;
+  /* 0 if the service is the protocol itself */
+  GQuark service;
+}
+ServiceKey;
+
+typedef struct
+{
+  ServiceKey key;
+  RtcomAccountPlugin *plugin;
+  RtcomAccountService *service;
+}
+DispatcherEntry;
+
+/* Routes the events of the shared account manager to the plugin owning the
+ * service of the account, so plugins don't see each other's accounts. */
+typedef struct
+{
+  TpAccountManager *manager;
+  gulong account_validity_changed_id;
+  gulong account_removed_id;
+  /* registered plugins, first registered first */
+  GList *plugins;
+  /* key is ServiceKey, value is DispatcherEntry */
+  GHashTable *services;
+}
+AccountDispatcher;
+
+static AccountDispatcher *dispatcher = NULL;
+
 static RtcomAccountItem *
 rtcom_account_plugin_get_account_by_name(RtcomAccountPlugin *plugin,
                                          const gchar *name)
 {
-  GList *accounts;
-  GList *l;
-  RtcomAccountItem *item = NULL;
-  AccountsList *accounts_list = NULL;
+  g_return_val_if_fail(name != NULL, NULL);
 
-  g_object_get(plugin, "accounts-list", &accounts_list, NULL);
-  accounts = accounts_list_get_all(accounts_list);
-  g_object_unref(accounts_list);
+  return g_hash_table_lookup(PRIVATE(plugin)->accounts, name);
+}
 
-  for (l = accounts; l; l = l->next)
-  {
-    if (RTCOM_IS_ACCOUNT_ITEM(l->data) &&
-        (account_item_get_plugin(ACCOUNT_ITEM(l->data)) ==
-         ACCOUNT_PLUGIN(plugin)))
-    {
-      const gchar *item_name = rtcom_account_item_get_unique_name(l->data);
+static void
+rtcom_account_plugin_add_account(RtcomAccountPlugin *plugin,
+                                 AccountsList *accounts_list,
+                                 RtcomAccountItem *item)
+{
+  const gchar *name = rtcom_account_item_get_unique_name(item);
 
-      if (item_name && !strcmp(item_name, name))
-      {
-        item = l->data;
-        break;
-      }
-    }
+  if (name)
+  {
+    g_hash_table_insert(PRIVATE(plugin)->accounts, g_strdup(name),
+                        g_object_ref(item));
   }
 
-  g_list_free(accounts);
-
-  return item;
+  accounts_list_add(accounts_list, ACCOUNT_ITEM(item));
 }
 
 static void
-on_account_removed_cb(TpAccountManager *am, TpAccount *account,
-                      RtcomAccountPlugin *plugin)
+remove_account(RtcomAccountPlugin *plugin, TpAccount *account)
 {
-  RtcomAccountItem *item = rtcom_account_plugin_get_account_by_name(
-      plugin, tp_account_get_path_suffix(account));
+  RtcomAccountPluginPrivate *priv = PRIVATE(plugin);
+  const gchar *name = tp_account_get_path_suffix(account);
+  RtcomAccountItem *item = rtcom_account_plugin_get_account_by_name(plugin,
+                                                                    name);
 
   if (item)
   {
     AccountsList *accounts_list = NULL;
 
+    g_object_ref(item);
+    g_hash_table_remove(priv->accounts, name);
     g_object_get(plugin, "accounts-list", &accounts_list, NULL);
     accounts_list_remove(accounts_list, ACCOUNT_ITEM(item));
     g_object_unref(accounts_list);
+    g_object_unref(item);
+  }
+}
+
+static void
+account_validity_changed(RtcomAccountPlugin *plugin, TpAccount *account,
+                         RtcomAccountService *service, gboolean valid)
+{
+  if (valid)
+  {
+    if (!rtcom_account_plugin_get_account_by_name(
+          plugin, tp_account_get_path_suffix(account)))
+    {
+      RtcomAccountItem *item = rtcom_account_item_new(account, service);
+      AccountsList *accounts_list = NULL;
+
+      g_object_get(plugin, "accounts-list", &accounts_list, NULL);
+      rtcom_account_plugin_add_account(plugin, accounts_list, item);
+      g_object_unref(accounts_list);
+      g_object_unref(item);
+    }
   }
+  else
+    remove_account(plugin, account);
 }
 
 static gchar *
@@ -119,37 +174,192 @@ get_service_id(TpAccount *account)
   }
 }
 
+static guint
+service_key_hash(gconstpointer key)
+{
+  const ServiceKey *k = key;
+
+  return (k->cm * 31 + k->protocol) * 31 + k->service;
+}
+
+static gboolean
+service_key_equal(gconstpointer a, gconstpointer b)
+{
+  const ServiceKey *ka = a;
+  const ServiceKey *kb = b;
+
+  return ka->cm == kb->cm && ka->protocol == kb->protocol &&
+         ka->service == kb->service;
+}
+
+/* only finds the quarks, returns FALSE if no service can match @account */
+static gboolean
+service_key_from_account(ServiceKey *key, TpAccount *account)
+{
+  const gchar *protocol_name = tp_account_get_protocol_name(account);
+  const gchar *service = tp_account_get_service(account);
+
+  key->cm = g_quark_try_string(tp_account_get_cm_name(account));
+  key->protocol = g_quark_try_string(protocol_name);
+
+  if (!key->cm || !key->protocol)
+    return FALSE;
+
+  if (!service || !*service || !strcmp(service, protocol_name))
+    key->service = 0;
+  else if (!(key->service = g_quark_try_string(service)))
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+service_key_from_id(ServiceKey *key, const gchar *service_id)
+{
+  GStrv arr = g_strsplit(service_id, "/", 3);
+
+  /* ids were checked by rtcom_account_plugin_add_service() */
+  key->cm = g_quark_from_string(arr[0]);
+  key->protocol = g_quark_from_string(arr[1]);
+  key->service = arr[2] ? g_quark_from_string(arr[2]) : 0;
+
+  g_strfreev(arr);
+}
+
+/* returns the service of @account and the plugin owning it, if any */
+static DispatcherEntry *
+dispatcher_lookup(TpAccount *account)
+{
+  ServiceKey key;
+
+  if (!service_key_from_account(&key, account))
+    return NULL;
+
+  return g_hash_table_lookup(dispatcher->services, &key);
+}
+
+static void
+on_account_removed_cb(TpAccountManager *am, TpAccount *account,
+                      gpointer user_data)
+{
+  DispatcherEntry *entry = dispatcher_lookup(account);
+
+  if (entry)
+    remove_account(entry->plugin, account);
+}
+
 static void
 on_account_validity_changed_cb(TpAccountManager *am, TpAccount *account,
                                gboolean valid, gpointer user_data)
 {
-  if (valid)
+  DispatcherEntry *entry = dispatcher_lookup(account);
+
+  if (entry)
+    account_validity_changed(entry->plugin, account, entry->service, valid);
+}
+
+static void
+dispatcher_entry_free(gpointer data)
+{
+  g_slice_free(DispatcherEntry, data);
+}
+
+/* the first plugin keeps the service, the others only get it once the
+ * owner is gone */
+static void
+dispatcher_claim_services(RtcomAccountPlugin *plugin, gboolean warn)
+{
+  GHashTableIter iter;
+  gpointer service_id;
+  gpointer service;
+
+  g_hash_table_iter_init(&iter, plugin->services);
+
+  while (g_hash_table_iter_next(&iter, &service_id, &service))
   {
-    RtcomAccountPlugin *plugin = user_data;
+    DispatcherEntry *owner;
+    ServiceKey key;
 
-    if (!rtcom_account_plugin_get_account_by_name(
-          plugin, tp_account_get_path_suffix(account)))
+    service_key_from_id(&key, service_id);
+    owner = g_hash_table_lookup(dispatcher->services, &key);
+
+    if (!owner)
     {
-      RtcomAccountService *service;
-      AccountsList *accounts_list = NULL;
-      gchar *service_id = get_service_id(account);
+      DispatcherEntry *entry = g_slice_new(DispatcherEntry);
 
-      service = g_hash_table_lookup(plugin->services, service_id);
-      g_free(service_id);
+      entry->key = key;
+      entry->plugin = plugin;
+      entry->service = service;
+      g_hash_table_insert(dispatcher->services, &entry->key, entry);
+    }
+    else if (warn && owner->plugin != plugin)
+    {
+      g_warning("%s: service %s of plugin %s is already provided by %s",
+                __FUNCTION__, (const gchar *)service_id,
+                account_plugin_get_name(ACCOUNT_PLUGIN(plugin)),
+                account_plugin_get_name(ACCOUNT_PLUGIN(owner->plugin)));
+    }
+  }
+}
 
-      if (service)
-      {
-        RtcomAccountItem *item = rtcom_account_item_new(account, service);
+static void
+dispatcher_register(RtcomAccountPlugin *plugin)
+{
+  if (!dispatcher)
+  {
+    dispatcher = g_slice_new(AccountDispatcher);
+    dispatcher->manager = g_object_ref(plugin->manager);
+    dispatcher->plugins = NULL;
+    dispatcher->services = g_hash_table_new_full(
+        service_key_hash, service_key_equal, NULL, dispatcher_entry_free);
+    dispatcher->account_validity_changed_id =
+      g_signal_connect(dispatcher->manager, "account-validity-changed",
+                       G_CALLBACK(on_account_validity_changed_cb), NULL);
+    dispatcher->account_removed_id =
+      g_signal_connect(dispatcher->manager, "account-removed",
+                       G_CALLBACK(on_account_removed_cb), NULL);
+  }
 
-        g_object_get(plugin, "accounts-list", &accounts_list, NULL);
-        accounts_list_add(accounts_list, ACCOUNT_ITEM(item));
-        g_object_unref(accounts_list);
-        g_object_unref(item);
-      }
-    }
+  g_warn_if_fail(dispatcher->manager == plugin->manager);
+
+  dispatcher->plugins = g_list_append(dispatcher->plugins, plugin);
+  dispatcher_claim_services(plugin, TRUE);
+}
+
+static gboolean
+remove_plugin(gpointer key, gpointer value, gpointer user_data)
+{
+  return ((DispatcherEntry *)value)->plugin == user_data;
+}
+
+static void
+dispatcher_unregister(RtcomAccountPlugin *plugin)
+{
+  GList *l;
+
+  if (!dispatcher)
+    return;
+
+  dispatcher->plugins = g_list_remove(dispatcher->plugins, plugin);
+
+  /* services it owned go to the next plugin providing them */
+  if (g_hash_table_foreach_remove(dispatcher->services, remove_plugin, plugin))
+  {
+    for (l = dispatcher->plugins; l; l = l->next)
+      dispatcher_claim_services(l->data, FALSE);
+  }
+
+  if (!dispatcher->plugins)
+  {
+    g_signal_handler_disconnect(dispatcher->manager,
+                                dispatcher->account_validity_changed_id);
+    g_signal_handler_disconnect(dispatcher->manager,
+                                dispatcher->account_removed_id);
+    g_object_unref(dispatcher->manager);
+    g_hash_table_destroy(dispatcher->services);
+    g_slice_free(AccountDispatcher, dispatcher);
+    dispatcher = NULL;
   }
-  else
-    on_account_removed_cb(am, account, user_data);
 }
 
 static void
@@ -158,27 +368,23 @@ rtcom_account_plugin_dispose(GObject *object)
   RtcomAccountPlugin *plugin = RTCOM_ACCOUNT_PLUGIN(object);
   RtcomAccountPluginPrivate *priv = PRIVATE(object);
 
+  if (priv->initialized)
+    dispatcher_unregister(plugin);
+
   if (plugin->services)
   {
     g_hash_table_destroy(plugin->services);
     plugin->services = NULL;
   }
 
-  if (plugin->manager)
+  if (priv->accounts)
   {
-    if (priv->account_validity_changed_id)
-    {
-      g_signal_handler_disconnect(plugin->manager,
-                                  priv->account_validity_changed_id);
-      priv->account_validity_changed_id = 0;
-    }
-
-    if (priv->account_removed_id)
-    {
-      g_signal_handler_disconnect(plugin->manager, priv->account_removed_id);
-      priv->account_removed_id = 0;
-    }
+    g_hash_table_destroy(priv->accounts);
+    priv->accounts = NULL;
+  }
 
+  if (plugin->manager)
+  {
     g_object_unref(plugin->manager);
     plugin->manager = NULL;
   }
@@ -220,14 +426,10 @@ _add_accounts(RtcomAccountPlugin *plugin)
   AccountsList *accounts_list = NULL;
   GList *accounts;
   GList *l;
+  gint64 begin = rtcom_trace_begin();
 
   priv->initialized = TRUE;
-  priv->account_validity_changed_id =
-      g_signal_connect(plugin->manager, "account-validity-changed",
-                       G_CALLBACK(on_account_validity_changed_cb), plugin);
-  priv->account_removed_id =
-      g_signal_connect(plugin->manager, "account-removed",
-                       G_CALLBACK(on_account_removed_cb), plugin);
+  dispatcher_register(plugin);
 
   g_object_get(plugin, "accounts-list", &accounts_list, NULL);
 
@@ -242,8 +444,10 @@ _add_accounts(RtcomAccountPlugin *plugin)
 
     if (svc)
     {
-      accounts_list_add(accounts_list,
-                        ACCOUNT_ITEM(rtcom_account_item_new(l->data, svc)));
+      RtcomAccountItem *item = rtcom_account_item_new(l->data, svc);
+
+      rtcom_account_plugin_add_account(plugin, accounts_list, item);
+      g_object_unref(item);
     }
 
     g_free(service_id);
@@ -252,6 +456,9 @@ _add_accounts(RtcomAccountPlugin *plugin)
   g_list_free_full(accounts, g_object_unref);
   g_object_unref(accounts_list);
 
+  rtcom_trace_end(begin, "add-accounts",
+                  account_plugin_get_name(ACCOUNT_PLUGIN(plugin)));
+
   g_object_notify(G_OBJECT(plugin), "initialized");
 }
 
@@ -315,6 +522,12 @@ rtcom_account_plugin_list_services(AccountPlugin *account_plugin)
 static void
 rtcom_account_plugin_deleted(AccountPlugin *plugin, AccountItem *account_item)
 {
+  const gchar *name = rtcom_account_item_get_unique_name(
+      RTCOM_ACCOUNT_ITEM(account_item));
+
+  if (name)
+    g_hash_table_remove(PRIVATE(plugin)->accounts, name);
+
   rtcom_account_item_delete(RTCOM_ACCOUNT_ITEM(account_item));
 }
 
@@ -360,6 +573,9 @@ on_manager_ready(GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
   GError *error = NULL;
 
+  rtcom_trace_end(PRIVATE(user_data)->manager_prepare_begin,
+                  "account-manager-prepare", NULL);
+
   if (!tp_proxy_prepare_finish(source_object, res, &error))
   {
     if (error)
@@ -383,11 +599,14 @@ rtcom_account_plugin_init(RtcomAccountPlugin *plugin)
       (GEqualFunc)&g_str_equal,
       (GDestroyNotify)&g_free,
       (GDestroyNotify)&g_object_unref);
+  priv->accounts = g_hash_table_new_full(
+      (GHashFunc)&g_str_hash,
+      (GEqualFunc)&g_str_equal,
+      (GDestroyNotify)&g_free,
+      (GDestroyNotify)&g_object_unref);
 
   priv->initialized = FALSE;
   priv->pending_services = NULL;
-  priv->account_validity_changed_id = 0;
-  priv->account_removed_id = 0;
 }
 
 static void
@@ -406,7 +625,10 @@ service_ready_cb(RtcomAccountService *service, GError *error,
   if (!priv->pending_services)
   {
     if (!tp_proxy_is_prepared(plugin->manager, TP_ACCOUNT_MANAGER_FEATURE_CORE))
+    {
+      priv->manager_prepare_begin = rtcom_trace_begin();
       tp_proxy_prepare_async(plugin->manager, NULL, on_manager_ready, plugin);
+    }
     else
       _add_accounts(user_data);
   }
@@ -420,11 +642,13 @@ rtcom_account_plugin_add_service(RtcomAccountPlugin *plugin,
   RtcomAccountService *service = NULL;
   GStrv arr;
   guint len;
+  gint64 begin;
 
   g_return_val_if_fail(service_id != NULL, NULL);
 
   g_assert(priv->initialized == FALSE);
 
+  begin = rtcom_trace_begin();
   arr = g_strsplit(service_id, "/", 3);
   len = g_strv_length(arr);
 
@@ -475,6 +699,8 @@ error:
   if (!service)
     g_warning("Invalid service id, must be <cm_name/protocol_name>[/service]");
 
+  rtcom_trace_end(begin, "add-service", service_id);
+
   return service;
 }
 
@@ -27,13 +27,28 @@
 #include <telepathy-glib/debug.h>
 
 #include "rtcom-account-service.h"
+#include "rtcom-protocol-cache.h"
+#include "rtcom-trace.h"
 
-G_DEFINE_TYPE(
+struct _RtcomAccountServicePrivate
+{
+  /* key is parameter name, value is RtcomParamSchema */
+  GHashTable *params;
+};
+
+typedef struct _RtcomAccountServicePrivate RtcomAccountServicePrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE(
   RtcomAccountService,
   rtcom_account_service,
   ACCOUNT_TYPE_SERVICE
 );
 
+#define PRIVATE(service) \
+  ((RtcomAccountServicePrivate *) \
+   rtcom_account_service_get_instance_private( \
+     (RtcomAccountService *)(service)))
+
 enum
 {
   READY,
@@ -43,11 +58,21 @@ enum
 static guint signals[LAST_SIGNAL] = { 0 };
 
 static GQuark connection_data_quark = 0;
+/* set on a TpConnectionManager once its protocols are in the cache */
+static GQuark cache_stored_quark = 0;
+
+/* CM name -> TpConnectionManager, shared by all services in the process, so
+ * every CM is activated and introspected only once no matter how many
+ * services (protocols/profiles) it backs. Pending prepare requests on the
+ * same proxy are completed together by telepathy-glib. Proxies that failed
+ * to prepare or got invalidated are dropped and created again on demand. */
+static GHashTable *cm_registry = NULL;
 
 static void
 rtcom_account_service_dispose(GObject *object)
 {
   RtcomAccountService *service = RTCOM_ACCOUNT_SERVICE(object);
+  RtcomAccountServicePrivate *priv = PRIVATE(service);
 
   if (service->protocol)
   {
@@ -55,6 +80,12 @@ rtcom_account_service_dispose(GObject *object)
     service->protocol = NULL;
   }
 
+  if (priv->params)
+  {
+    g_hash_table_destroy(priv->params);
+    priv->params = NULL;
+  }
+
   G_OBJECT_CLASS(rtcom_account_service_parent_class)->dispose(object);
 }
 
@@ -69,16 +100,188 @@ rtcom_account_service_finalize(GObject *object)
   G_OBJECT_CLASS(rtcom_account_service_parent_class)->finalize(object);
 }
 
+static GType
+param_type_from_signature(const gchar *name, const gchar *signature)
+{
+  switch (signature[0])
+  {
+    case DBUS_TYPE_BOOLEAN:
+    {
+      return G_TYPE_BOOLEAN;
+    }
+    case DBUS_TYPE_INT16:
+    /* fall-through */
+    case DBUS_TYPE_INT32:
+    {
+      return G_TYPE_INT;
+    }
+    case DBUS_TYPE_UINT16:
+    case DBUS_TYPE_UINT32:
+    {
+      return G_TYPE_UINT;
+    }
+    case DBUS_TYPE_STRING:
+    {
+      return G_TYPE_STRING;
+    }
+    default:
+    {
+      g_warning("%s: parameter %s, unknown type %s",
+                __FUNCTION__, name, signature);
+      break;
+    }
+  }
+
+  return G_TYPE_INVALID;
+}
+
 static void
-cm_prepared_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+param_schema_free(RtcomParamSchema *schema)
+{
+  if (G_IS_VALUE(&schema->default_value))
+    g_value_unset(&schema->default_value);
+
+  g_slice_free(RtcomParamSchema, schema);
+}
+
+/* decodes the parameters of @protocol once, so widgets don't have to query
+ * the protocol for every field */
+static GHashTable *
+build_param_schema(TpProtocol *protocol)
+{
+  GHashTable *params = g_hash_table_new_full(
+      (GHashFunc)&g_str_hash,
+      (GEqualFunc)&g_str_equal,
+      (GDestroyNotify)&g_free,
+      (GDestroyNotify)&param_schema_free);
+  GStrv names = tp_protocol_dup_param_names(protocol);
+  GStrv name;
+
+  for (name = names; name && *name; name++)
+  {
+    const TpConnectionManagerParam *param;
+    RtcomParamSchema *schema;
+
+    param = tp_protocol_get_param(protocol, *name);
+
+    if (!param)
+      continue;
+
+    schema = g_slice_new0(RtcomParamSchema);
+    schema->type = param_type_from_signature(
+        *name, tp_connection_manager_param_get_dbus_signature(param));
+
+    if (tp_connection_manager_param_is_required(param))
+      schema->flags |= TP_CONN_MGR_PARAM_FLAG_REQUIRED;
+
+    if (tp_connection_manager_param_is_required_for_registration(param))
+      schema->flags |= TP_CONN_MGR_PARAM_FLAG_REGISTER;
+
+    if (tp_connection_manager_param_is_secret(param))
+      schema->flags |= TP_CONN_MGR_PARAM_FLAG_SECRET;
+
+    if (tp_connection_manager_param_is_dbus_property(param))
+      schema->flags |= TP_CONN_MGR_PARAM_FLAG_DBUS_PROPERTY;
+
+    if (tp_connection_manager_param_get_default(param,
+                                                &schema->default_value))
+    {
+      schema->flags |= TP_CONN_MGR_PARAM_FLAG_HAS_DEFAULT;
+    }
+
+    g_hash_table_insert(params, g_strdup(*name), schema);
+  }
+
+  g_strfreev(names);
+
+  return params;
+}
+
+static void
+set_protocol(AccountService *service, TpProtocol *protocol)
+{
+  RtcomAccountService *rtcom_service = RTCOM_ACCOUNT_SERVICE(service);
+
+  rtcom_service->protocol = g_object_ref(protocol);
+  PRIVATE(rtcom_service)->params = build_param_schema(protocol);
+
+  if (!service->display_name)
+  {
+    GStrv arr = g_strsplit(service->name, "/", 3);
+
+    service->display_name =
+      g_strconcat(tp_protocol_get_english_name(protocol),
+                  " (", arr[0], ")", NULL);
+    g_strfreev(arr);
+  }
+
+  if (!service->icon)
+  {
+    const gchar *icon_name = tp_protocol_get_icon_name(protocol);
+
+    if (icon_name)
+    {
+      service->icon = gtk_icon_theme_load_icon(
+          gtk_icon_theme_get_default(), icon_name, 48, 0, NULL);
+    }
+  }
+}
+
+static gboolean
+emit_ready_idle(gpointer user_data)
 {
   AccountService *service = user_data;
+
+  g_signal_emit(service, signals[READY], 0, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+struct cm_prepare_data
+{
+  AccountService *service;
+  gint64 begin;
+};
+
+static void cm_invalidated_cb(TpProxy *proxy, guint domain, gint code,
+                              gchar *message, gpointer user_data);
+
+/* drops @cm from the registry, so the next request creates a new proxy */
+static void
+cm_registry_remove(TpConnectionManager *cm)
+{
+  const gchar *cm_name = tp_connection_manager_get_name(cm);
+
+  g_signal_handlers_disconnect_matched(
+    cm, G_SIGNAL_MATCH_DATA | G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+    cm_invalidated_cb, NULL);
+
+  if (cm_registry && (g_hash_table_lookup(cm_registry, cm_name) == cm))
+    g_hash_table_remove(cm_registry, cm_name);
+}
+
+static void
+cm_invalidated_cb(TpProxy *proxy, guint domain, gint code, gchar *message,
+                  gpointer user_data)
+{
+  cm_registry_remove(TP_CONNECTION_MANAGER(proxy));
+}
+
+static void
+cm_prepared_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+{
+  struct cm_prepare_data *data = user_data;
+  AccountService *service = data->service;
   TpConnectionManager *cm = (TpConnectionManager *)object;
   GError *error = NULL;
 
+  rtcom_trace_end(data->begin, "cm-prepare", service->name);
+  g_slice_free(struct cm_prepare_data, data);
+
   if (!tp_proxy_prepare_finish(object, res, &error))
   {
     g_warning("Error preparing connection manager: %s\n", error->message);
+    cm_registry_remove(cm);
     g_signal_emit(service, signals[READY], 0, error);
 
     g_error_free(error);
@@ -87,33 +290,20 @@ cm_prepared_cb(GObject *object, GAsyncResult *res, gpointer user_data)
   {
     GStrv arr = g_strsplit(service->name, "/", 3);
     TpProtocol *protocol;
-    const gchar *icon_name;
 
     protocol = tp_connection_manager_get_protocol_object(cm, arr[1]);
-    RTCOM_ACCOUNT_SERVICE(service)->protocol = protocol;
 
     g_warn_if_fail(protocol != NULL);
 
     if (protocol)
     {
-      g_object_ref(protocol);
-
-      if (!service->display_name)
-      {
-        service->display_name =
-          g_strconcat(tp_protocol_get_english_name(protocol),
-                      " (", arr[0], ")", NULL);
-      }
+      set_protocol(service, protocol);
 
-      if (!service->icon)
+      /* every service of a shared CM gets here, write the cache once */
+      if (!g_object_get_qdata(object, cache_stored_quark))
       {
-        icon_name = tp_protocol_get_icon_name(protocol);
-
-        if (icon_name)
-        {
-          service->icon = gtk_icon_theme_load_icon(
-              gtk_icon_theme_get_default(), icon_name, 48, 0, NULL);
-        }
+        rtcom_protocol_cache_store(cm);
+        g_object_set_qdata(object, cache_stored_quark, GINT_TO_POINTER(1));
       }
     }
 
@@ -124,6 +314,42 @@ cm_prepared_cb(GObject *object, GAsyncResult *res, gpointer user_data)
   g_object_unref(service);
 }
 
+static TpConnectionManager *
+dup_connection_manager(const gchar *cm_name, GError **error)
+{
+  TpConnectionManager *cm;
+
+  if (!cm_registry)
+  {
+    cm_registry = g_hash_table_new_full((GHashFunc)&g_str_hash,
+                                        (GEqualFunc)&g_str_equal,
+                                        (GDestroyNotify)&g_free,
+                                        (GDestroyNotify)&g_object_unref);
+  }
+
+  cm = g_hash_table_lookup(cm_registry, cm_name);
+
+  if (!cm)
+  {
+    TpDBusDaemon *dbus_daemon = tp_dbus_daemon_dup(error);
+
+    if (!dbus_daemon)
+      return NULL;
+
+    cm = tp_connection_manager_new(dbus_daemon, cm_name, NULL, error);
+    g_object_unref(dbus_daemon);
+
+    if (!cm)
+      return NULL;
+
+    tp_connection_manager_activate(cm);
+    g_signal_connect(cm, "invalidated", G_CALLBACK(cm_invalidated_cb), NULL);
+    g_hash_table_insert(cm_registry, g_strdup(cm_name), cm);
+  }
+
+  return g_object_ref(cm);
+}
+
 static void
 get_service_properties(AccountService *service)
 {
@@ -131,8 +357,8 @@ get_service_properties(AccountService *service)
   const gchar *cm_name = NULL;
   const gchar *protocol_name = NULL;
   GError *error = NULL;
-  TpDBusDaemon *dbus_daemon;
-  TpConnectionManager *cm = NULL;
+  TpConnectionManager *cm;
+  TpProtocol *protocol;
 
   if (arr && arr[0] && arr[1])
   {
@@ -146,14 +372,22 @@ get_service_properties(AccountService *service)
   if (!cm_name || !protocol_name)
     goto err;
 
-  dbus_daemon = tp_dbus_daemon_dup(&error);
+  /* Cached metadata makes the service ready without spawning the CM, it is
+   * activated later on, when a connection is requested */
+  protocol = rtcom_protocol_cache_lookup(cm_name, protocol_name);
 
-  if (dbus_daemon)
+  if (protocol)
   {
-    cm = tp_connection_manager_new(dbus_daemon, cm_name, NULL, &error);
-    g_object_unref(dbus_daemon);
+    rtcom_trace_mark("protocol-cache-hit", service->name);
+    set_protocol(service, protocol);
+    g_object_unref(protocol);
+    g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, emit_ready_idle,
+                    g_object_ref(service), (GDestroyNotify)&g_object_unref);
+    goto err;
   }
 
+  cm = dup_connection_manager(cm_name, &error);
+
   if (error)
   {
     g_warning("%s: Failed to create connection manager for %s: [%s]",
@@ -163,8 +397,11 @@ get_service_properties(AccountService *service)
   }
   else
   {
-    tp_connection_manager_activate(cm);
-    tp_proxy_prepare_async(cm, NULL, cm_prepared_cb, g_object_ref(service));
+    struct cm_prepare_data *data = g_slice_new(struct cm_prepare_data);
+
+    data->service = g_object_ref(service);
+    data->begin = rtcom_trace_begin();
+    tp_proxy_prepare_async(cm, NULL, cm_prepared_cb, data);
     g_object_unref(cm);
   }
 
@@ -215,6 +452,7 @@ static void
 rtcom_account_service_init(RtcomAccountService *service)
 {
   connection_data_quark = g_quark_from_static_string("connection-data");
+  cache_stored_quark = g_quark_from_static_string("rtcom-cache-stored");
 }
 
 RtcomAccountService *
@@ -518,16 +756,13 @@ _connectivity_ready(gpointer requester)
 
   if (cd->iaps)
   {
-    TpDBusDaemon *dbus;
     GError *error = NULL;
 
     if (cd->cm)
       return;
 
-    dbus = rtcom_account_plugin_get_dbus_daemon(
-        RTCOM_ACCOUNT_PLUGIN(ACCOUNT_SERVICE(cd->service)->plugin));
-    cd->cm = tp_connection_manager_new(
-        dbus, tp_protocol_get_cm_name(cd->service->protocol), 0, &error);
+    cd->cm = dup_connection_manager(
+        tp_protocol_get_cm_name(cd->service->protocol), &error);
 
     if (error)
     {
@@ -665,45 +900,31 @@ GType
 rtcom_account_service_get_param_type(RtcomAccountService *service,
                                      const gchar *name)
 {
-  const TpConnectionManagerParam *param;
-  const gchar *signature;
+  const RtcomParamSchema *schema;
 
   g_return_val_if_fail(RTCOM_IS_ACCOUNT_SERVICE(service), G_TYPE_INVALID);
 
-  if (!tp_protocol_has_param(service->protocol, name))
+  schema = rtcom_account_service_get_param_schema(service, name);
+
+  if (!schema)
     return G_TYPE_INVALID;
 
-  param = tp_protocol_get_param(service->protocol, name);
-  signature = tp_connection_manager_param_get_dbus_signature(param);
+  return schema->type;
+}
 
-  switch (signature[0])
-  {
-    case DBUS_TYPE_BOOLEAN:
-    {
-      return G_TYPE_BOOLEAN;
-    }
-    case DBUS_TYPE_INT16:
-    /* fall-through */
-    case DBUS_TYPE_INT32:
-    {
-      return G_TYPE_INT;
-    }
-    case DBUS_TYPE_UINT16:
-    case DBUS_TYPE_UINT32:
-    {
-      return G_TYPE_UINT;
-    }
-    case DBUS_TYPE_STRING:
-    {
-      return G_TYPE_STRING;
-    }
-    default:
-    {
-      g_warning("%s: parameter %s, unknown type %s",
-                __FUNCTION__, name, signature);
-      break;
-    }
-  }
+const RtcomParamSchema *
+rtcom_account_service_get_param_schema(RtcomAccountService *service,
+                                       const gchar *name)
+{
+  GHashTable *params;
 
-  return G_TYPE_INVALID;
+  g_return_val_if_fail(RTCOM_IS_ACCOUNT_SERVICE(service), NULL);
+  g_return_val_if_fail(name != NULL, NULL);
+
+  params = PRIVATE(service)->params;
+
+  if (!params)
+    return NULL;
+
+  return g_hash_table_lookup(params, name);
 }
@@ -42,6 +42,15 @@ typedef struct _RtcomAccountService RtcomAccountService;
  * proxy will be NULL if there is error */
 typedef void (*RtcomAccountServiceConnectionCb) (GObject *, TpConnection *, GError *, gpointer);
 
+/* Protocol parameter as needed by the widgets, decoded once per service */
+typedef struct
+{
+    GType type;
+    TpConnMgrParamFlags flags;
+    /* unset if the parameter has no default */
+    GValue default_value;
+} RtcomParamSchema;
+
 struct _RtcomAccountServiceClass
 {
     AccountServiceClass parent_class;
@@ -65,6 +74,9 @@ RtcomAccountService *rtcom_account_service_new (const gchar *name,
 TpProtocol *rtcom_account_service_get_protocol (RtcomAccountService *service);
 GType rtcom_account_service_get_param_type (RtcomAccountService *service,
                                             const gchar *name);
+const RtcomParamSchema *
+rtcom_account_service_get_param_schema (RtcomAccountService *service,
+                                        const gchar *name);
 
 void rtcom_account_service_connect (RtcomAccountService *service,
                                     GHashTable *params,
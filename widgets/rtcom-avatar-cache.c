@@ -0,0 +1,377 @@
+/*
+ * rtcom-avatar-cache.c
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "rtcom-avatar-cache.h"
+
+/* decoded pixbufs kept alive by the cache, in bytes of pixel data */
+#define AVATAR_CACHE_BUDGET (4 * 1024 * 1024)
+
+typedef struct
+{
+  gchar *key;
+  GdkPixbuf *pixbuf;
+  gsize size;
+}
+AvatarCacheEntry;
+
+typedef struct
+{
+  /* key is "<sha1 of data>:<width>x<height>", value is GList link in lru */
+  GHashTable *entries;
+  /* most recently used first */
+  GQueue lru;
+  gsize size;
+}
+AvatarCache;
+
+static AvatarCache *cache = NULL;
+
+static void
+avatar_cache_entry_free(AvatarCacheEntry *entry)
+{
+  g_object_unref(entry->pixbuf);
+  g_free(entry->key);
+  g_slice_free(AvatarCacheEntry, entry);
+}
+
+static AvatarCache *
+get_cache(void)
+{
+  if (!cache)
+  {
+    cache = g_new0(AvatarCache, 1);
+    cache->entries = g_hash_table_new((GHashFunc)&g_str_hash,
+                                      (GEqualFunc)&g_str_equal);
+    g_queue_init(&cache->lru);
+  }
+
+  return cache;
+}
+
+static void
+avatar_cache_remove_link(AvatarCache *c, GList *link)
+{
+  AvatarCacheEntry *entry = link->data;
+
+  g_hash_table_remove(c->entries, entry->key);
+  g_queue_delete_link(&c->lru, link);
+  c->size -= entry->size;
+  avatar_cache_entry_free(entry);
+}
+
+static void
+avatar_cache_trim(AvatarCache *c, gsize budget)
+{
+  /* always keep the most recently used entry, even if it is over budget */
+  while (c->size > budget && c->lru.length > 1)
+    avatar_cache_remove_link(c, c->lru.tail);
+}
+
+static GdkPixbuf *
+decode_pixbuf(const guchar *data, gsize len, const gchar *mime_type,
+              gint width, gint height)
+{
+  GdkPixbufLoader *loader;
+  GdkPixbuf *pixbuf = NULL;
+
+  if (mime_type && *mime_type)
+    loader = gdk_pixbuf_loader_new_with_mime_type(mime_type, NULL);
+  else
+    loader = gdk_pixbuf_loader_new();
+
+  if (!loader)
+    return NULL;
+
+  if (width > 0 && height > 0)
+    gdk_pixbuf_loader_set_size(loader, width, height);
+
+  if (gdk_pixbuf_loader_write(loader, data, len, NULL))
+  {
+    gdk_pixbuf_loader_close(loader, NULL);
+    pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+
+    if (pixbuf)
+      g_object_ref(pixbuf);
+  }
+  else
+    gdk_pixbuf_loader_close(loader, NULL);
+
+  g_object_unref(loader);
+
+  return pixbuf;
+}
+
+static gchar *
+avatar_cache_key(const guchar *data, gsize len, gint width, gint height)
+{
+  gchar *checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA1, data, len);
+  gchar *key = g_strdup_printf("%s:%dx%d", checksum, width, height);
+
+  g_free(checksum);
+
+  return key;
+}
+
+static GdkPixbuf *
+avatar_cache_lookup(AvatarCache *c, const gchar *key)
+{
+  GList *link = g_hash_table_lookup(c->entries, key);
+
+  if (!link)
+    return NULL;
+
+  if (link != c->lru.head)
+  {
+    g_queue_unlink(&c->lru, link);
+    g_queue_push_head_link(&c->lru, link);
+  }
+
+  return g_object_ref(((AvatarCacheEntry *)link->data)->pixbuf);
+}
+
+/* takes @key */
+static void
+avatar_cache_insert(AvatarCache *c, gchar *key, GdkPixbuf *pixbuf)
+{
+  AvatarCacheEntry *entry;
+
+  /* decoded concurrently by another request */
+  if (g_hash_table_lookup(c->entries, key))
+  {
+    g_free(key);
+    return;
+  }
+
+  entry = g_slice_new(AvatarCacheEntry);
+  entry->key = key;
+  entry->pixbuf = g_object_ref(pixbuf);
+  entry->size = gdk_pixbuf_get_rowstride(pixbuf) *
+    gdk_pixbuf_get_height(pixbuf);
+
+  g_queue_push_head(&c->lru, entry);
+  g_hash_table_insert(c->entries, entry->key, c->lru.head);
+  c->size += entry->size;
+  avatar_cache_trim(c, AVATAR_CACHE_BUDGET);
+}
+
+GdkPixbuf *
+rtcom_avatar_cache_get_pixbuf(const guchar *data, gsize len,
+                              const gchar *mime_type, gint width, gint height)
+{
+  AvatarCache *c;
+  GdkPixbuf *pixbuf;
+  gchar *key;
+
+  if (!data || !len)
+    return NULL;
+
+  if (width <= 0 || height <= 0)
+    width = height = 0;
+
+  c = get_cache();
+  key = avatar_cache_key(data, len, width, height);
+  pixbuf = avatar_cache_lookup(c, key);
+
+  if (pixbuf)
+  {
+    g_free(key);
+    return pixbuf;
+  }
+
+  pixbuf = decode_pixbuf(data, len, mime_type, width, height);
+
+  if (pixbuf)
+    avatar_cache_insert(c, key, pixbuf);
+  else
+    g_free(key);
+
+  return pixbuf;
+}
+
+typedef struct
+{
+  GBytes *data;
+  gchar *mime_type;
+  gint width;
+  gint height;
+  gchar *key;
+}
+DecodeData;
+
+static void
+decode_data_free(DecodeData *d)
+{
+  g_bytes_unref(d->data);
+  g_free(d->mime_type);
+  g_free(d->key);
+  g_slice_free(DecodeData, d);
+}
+
+static void
+decode_thread(GTask *task, gpointer source_object, gpointer task_data,
+              GCancellable *cancellable)
+{
+  DecodeData *d = task_data;
+  GdkPixbuf *pixbuf;
+  gsize len;
+  const guchar *data = g_bytes_get_data(d->data, &len);
+
+  if (g_task_return_error_if_cancelled(task))
+    return;
+
+  pixbuf = decode_pixbuf(data, len, d->mime_type, d->width, d->height);
+
+  if (pixbuf)
+    g_task_return_pointer(task, pixbuf, (GDestroyNotify)&g_object_unref);
+  else
+  {
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                            "Unable to decode avatar image");
+  }
+}
+
+static void
+key_thread(GTask *task, gpointer source_object, gpointer task_data,
+           GCancellable *cancellable)
+{
+  DecodeData *d = task_data;
+  gsize len;
+  const guchar *data = g_bytes_get_data(d->data, &len);
+
+  if (g_task_return_error_if_cancelled(task))
+    return;
+
+  /* hashing a big image takes a while, so it is not done on the main
+   * thread either */
+  g_task_return_pointer(task, avatar_cache_key(data, len, d->width, d->height),
+                        (GDestroyNotify)&g_free);
+}
+
+static void
+key_ready_cb(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  GTask *task = user_data;
+  DecodeData *d = g_task_get_task_data(task);
+  GError *error = NULL;
+  GdkPixbuf *pixbuf;
+
+  d->key = g_task_propagate_pointer(G_TASK(res), &error);
+
+  if (!d->key)
+  {
+    g_task_return_error(task, error);
+    g_object_unref(task);
+    return;
+  }
+
+  /* the cache is only touched from the main thread */
+  pixbuf = avatar_cache_lookup(get_cache(), d->key);
+
+  if (pixbuf)
+    g_task_return_pointer(task, pixbuf, (GDestroyNotify)&g_object_unref);
+  else
+    g_task_run_in_thread(task, decode_thread);
+
+  g_object_unref(task);
+}
+
+void
+rtcom_avatar_cache_get_pixbuf_async(GBytes *data, const gchar *mime_type,
+                                    gint width, gint height,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data)
+{
+  GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+  GTask *key_task;
+  DecodeData *d;
+  gsize len;
+  const guchar *bytes = g_bytes_get_data(data, &len);
+
+  g_task_set_source_tag(task, rtcom_avatar_cache_get_pixbuf_async);
+
+  if (!bytes || !len)
+  {
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                            "No avatar data");
+    g_object_unref(task);
+    return;
+  }
+
+  if (width <= 0 || height <= 0)
+    width = height = 0;
+
+  d = g_slice_new(DecodeData);
+  d->data = g_bytes_ref(data);
+  d->mime_type = g_strdup(mime_type);
+  d->width = width;
+  d->height = height;
+  d->key = NULL;
+  g_task_set_task_data(task, d, (GDestroyNotify)&decode_data_free);
+
+  /* the key is computed in a worker, then looked up on the main thread and
+   * the image decoded in a worker again on a cache miss */
+  key_task = g_task_new(NULL, cancellable, key_ready_cb, task);
+  g_task_set_task_data(key_task, d, NULL);
+  g_task_run_in_thread(key_task, key_thread);
+  g_object_unref(key_task);
+}
+
+GdkPixbuf *
+rtcom_avatar_cache_get_pixbuf_finish(GAsyncResult *res, GError **error)
+{
+  GTask *task = G_TASK(res);
+  GdkPixbuf *pixbuf;
+
+  g_return_val_if_fail(g_task_is_valid(res, NULL), NULL);
+
+  pixbuf = g_task_propagate_pointer(task, error);
+
+  if (pixbuf)
+  {
+    DecodeData *d = g_task_get_task_data(task);
+    AvatarCache *c = get_cache();
+    GdkPixbuf *cached = avatar_cache_lookup(c, d->key);
+
+    /* the same image was decoded concurrently by another request */
+    if (cached)
+    {
+      g_object_unref(pixbuf);
+      pixbuf = cached;
+    }
+    else
+      avatar_cache_insert(c, g_strdup(d->key), pixbuf);
+  }
+
+  return pixbuf;
+}
+
+void
+rtcom_avatar_cache_clear(void)
+{
+  if (!cache)
+    return;
+
+  while (cache->lru.tail)
+    avatar_cache_remove_link(cache, cache->lru.tail);
+}
@@ -0,0 +1,54 @@
+/*
+ * rtcom-avatar-cache.h
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _RTCOM_AVATAR_CACHE_H_
+#define _RTCOM_AVATAR_CACHE_H_
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Returns a new reference to the pixbuf decoded from @data, scaled to
+ * @width x @height (decoded at natural size if either is <= 0), or NULL if
+ * the data cannot be decoded. @mime_type can be NULL to let gdk-pixbuf detect
+ * the image format. */
+GdkPixbuf *
+rtcom_avatar_cache_get_pixbuf(const guchar *data, gsize len,
+                              const gchar *mime_type, gint width, gint height);
+
+/* Same as rtcom_avatar_cache_get_pixbuf(), but the image is decoded in a
+ * worker thread. @callback is called in the thread-default main context and
+ * must call rtcom_avatar_cache_get_pixbuf_finish(). */
+void
+rtcom_avatar_cache_get_pixbuf_async(GBytes *data, const gchar *mime_type,
+                                    gint width, gint height,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data);
+
+GdkPixbuf *
+rtcom_avatar_cache_get_pixbuf_finish(GAsyncResult *res, GError **error);
+
+void
+rtcom_avatar_cache_clear(void);
+
+G_END_DECLS
+
+#endif /* _RTCOM_AVATAR_CACHE_H_ */
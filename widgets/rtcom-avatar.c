@@ -28,11 +28,23 @@
 
 #include <libintl.h>
 
+#include "rtcom-avatar-cache.h"
 #include "rtcom-avatar.h"
 
 struct _RtcomAvatarPrivate
 {
   gboolean check_size;
+  TpProxyPendingCall *get_avatar_call;
+  /* encoded data of src, as fetched from the account or encoded in the
+   * background after the user picked a new avatar */
+  GBytes *src_data;
+  gchar *src_mime;
+  /* src_data was already scaled down according to check_size */
+  gboolean src_scaled;
+  /* MIME type avatars are encoded to for the service being edited */
+  gchar *encode_mime;
+  GCancellable *decode_cancellable;
+  GCancellable *encode_cancellable;
 };
 
 typedef struct _RtcomAvatarPrivate RtcomAvatarPrivate;
@@ -47,17 +59,66 @@ RTCOM_DEFINE_WIDGET_TYPE_WITH_PRIVATE(
   GTK_TYPE_EVENT_BOX
 );
 
+static void
+cancel_task(GCancellable **cancellable)
+{
+  if (*cancellable)
+  {
+    g_cancellable_cancel(*cancellable);
+    g_object_unref(*cancellable);
+    *cancellable = NULL;
+  }
+}
+
+/* cancels fetching, decoding and encoding of the avatar */
+static void
+cancel_get_avatar(RtcomAvatar *avatar)
+{
+  RtcomAvatarPrivate *priv = PRIVATE(avatar);
+
+  if (priv->get_avatar_call)
+  {
+    tp_proxy_pending_call_cancel(priv->get_avatar_call);
+    priv->get_avatar_call = NULL;
+  }
+
+  cancel_task(&priv->decode_cancellable);
+  cancel_task(&priv->encode_cancellable);
+}
+
+static void
+clear_src_data(RtcomAvatar *avatar)
+{
+  RtcomAvatarPrivate *priv = PRIVATE(avatar);
+
+  if (priv->src_data)
+  {
+    g_bytes_unref(priv->src_data);
+    priv->src_data = NULL;
+  }
+
+  g_free(priv->src_mime);
+  priv->src_mime = NULL;
+  priv->src_scaled = FALSE;
+}
+
 static void
 rtcom_avatar_dispose(GObject *object)
 {
   RtcomAvatar *avatar = RTCOM_AVATAR(object);
 
+  cancel_get_avatar(avatar);
+  clear_src_data(avatar);
+
   if (avatar->src)
   {
     g_object_unref(avatar->src);
     avatar->src = NULL;
   }
 
+  g_free(PRIVATE(avatar)->encode_mime);
+  PRIVATE(avatar)->encode_mime = NULL;
+
   G_OBJECT_CLASS(rtcom_avatar_parent_class)->dispose(object);
 }
 
@@ -67,6 +128,140 @@ rtcom_avatar_class_init(RtcomAvatarClass *klass)
   G_OBJECT_CLASS(klass)->dispose = rtcom_avatar_dispose;
 }
 
+static GBytes *
+encode_avatar(GdkPixbuf *src, gboolean check_size, const gchar *mime,
+              GError **error)
+{
+  const char *type = strrchr(mime, '/');
+  GdkPixbuf *scaled = NULL;
+  gsize buffer_size;
+  gchar *buffer;
+  gboolean saved;
+
+  if (type)
+    type++;
+  else
+  {
+    g_warning("%s: Unexpected mime type: %s", __FUNCTION__, mime);
+    type = mime;
+  }
+
+  if (check_size)
+  {
+    if ((gdk_pixbuf_get_width(src) > OSSO_ABOOK_PIXEL_SIZE_AVATAR_MEDIUM) ||
+        (gdk_pixbuf_get_height(src) > OSSO_ABOOK_PIXEL_SIZE_AVATAR_MEDIUM))
+    {
+      scaled = gdk_pixbuf_scale_simple(src,
+                                       OSSO_ABOOK_PIXEL_SIZE_AVATAR_MEDIUM,
+                                       OSSO_ABOOK_PIXEL_SIZE_AVATAR_MEDIUM,
+                                       GDK_INTERP_BILINEAR);
+    }
+  }
+
+  saved = gdk_pixbuf_save_to_buffer(scaled ? scaled : src, &buffer,
+                                    &buffer_size, type, error, NULL);
+
+  if (scaled)
+    g_object_unref(scaled);
+
+  if (!saved)
+    return NULL;
+
+  return g_bytes_new_take(buffer, buffer_size);
+}
+
+typedef struct
+{
+  GdkPixbuf *src;
+  gboolean check_size;
+  gchar *mime;
+}
+EncodeData;
+
+static void
+encode_data_free(EncodeData *data)
+{
+  g_object_unref(data->src);
+  g_free(data->mime);
+  g_slice_free(EncodeData, data);
+}
+
+static void
+encode_thread(GTask *task, gpointer source_object, gpointer task_data,
+              GCancellable *cancellable)
+{
+  EncodeData *data = task_data;
+  GError *error = NULL;
+  GBytes *bytes;
+
+  if (g_task_return_error_if_cancelled(task))
+    return;
+
+  bytes = encode_avatar(data->src, data->check_size, data->mime, &error);
+
+  if (bytes)
+    g_task_return_pointer(task, bytes, (GDestroyNotify)&g_bytes_unref);
+  else
+    g_task_return_error(task, error);
+}
+
+static void
+avatar_encoded_cb(GObject *source_object, GAsyncResult *res,
+                  gpointer user_data)
+{
+  RtcomAvatar *avatar = user_data;
+  RtcomAvatarPrivate *priv;
+  GError *error = NULL;
+  GBytes *bytes = g_task_propagate_pointer(G_TASK(res), &error);
+
+  /* cancelled on dispose too, so @avatar must not be touched */
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+  {
+    g_error_free(error);
+    return;
+  }
+
+  priv = PRIVATE(avatar);
+  g_clear_object(&priv->encode_cancellable);
+
+  if (bytes)
+  {
+    EncodeData *data = g_task_get_task_data(G_TASK(res));
+
+    clear_src_data(avatar);
+    priv->src_data = bytes;
+    priv->src_mime = g_strdup(data->mime);
+    priv->src_scaled = data->check_size;
+  }
+  else
+  {
+    /* encoded again when the settings are stored */
+    g_warning("%s, Failed to encode avatar: %s", __FUNCTION__,
+              error->message);
+    g_error_free(error);
+  }
+}
+
+/* encodes the new avatar while the user is still editing the account, so
+ * storing the settings doesn't block the UI */
+static void
+encode_avatar_async(RtcomAvatar *avatar)
+{
+  RtcomAvatarPrivate *priv = PRIVATE(avatar);
+  EncodeData *data = g_slice_new(EncodeData);
+  GTask *task;
+
+  data->src = g_object_ref(avatar->src);
+  data->check_size = priv->check_size;
+  data->mime = g_strdup(priv->encode_mime ? priv->encode_mime : "image/png");
+
+  priv->encode_cancellable = g_cancellable_new();
+  task = g_task_new(NULL, priv->encode_cancellable, avatar_encoded_cb, avatar);
+  g_task_set_task_data(task, data, (GDestroyNotify)&encode_data_free);
+  g_task_run_in_thread(task, encode_thread);
+  g_object_unref(task);
+}
+
 static void
 _save_and_scale_avatar(RtcomAvatar *avatar, GdkPixbuf *pixbuf)
 {
@@ -75,6 +270,10 @@ _save_and_scale_avatar(RtcomAvatar *avatar, GdkPixbuf *pixbuf)
   g_return_if_fail(avatar);
   g_return_if_fail(pixbuf);
 
+  /* user picked a new avatar, ignore the one still being fetched */
+  cancel_get_avatar(avatar);
+  clear_src_data(avatar);
+
   if (avatar->src)
     g_object_unref(avatar->src);
 
@@ -86,6 +285,8 @@ _save_and_scale_avatar(RtcomAvatar *avatar, GdkPixbuf *pixbuf)
     OSSO_ABOOK_AVATAR_IMAGE(avatar->image),
     scaled);
   g_object_unref(scaled);
+
+  encode_avatar_async(avatar);
 }
 
 static void
@@ -121,10 +322,16 @@ _avatar_chooser_response_cb(OssoABookAvatarChooserDialog *chooser,
     {
       if (!strcmp(icon_name, "general_default_avatar"))
       {
+        cancel_get_avatar(avatar);
+        clear_src_data(avatar);
         osso_abook_avatar_image_set_pixbuf(
           OSSO_ABOOK_AVATAR_IMAGE(avatar->image), NULL);
-        g_object_unref(avatar->src);
-        avatar->src = NULL;
+
+        if (avatar->src)
+        {
+          g_object_unref(avatar->src);
+          avatar->src = NULL;
+        }
       }
       else if (pixbuf)
       {
@@ -177,81 +384,116 @@ rtcom_avatar_init(RtcomAvatar *avatar)
 }
 
 static gboolean
-rtcom_avatar_store_settings(RtcomWidget *widget, GError **error,
-                            RtcomAccountItem *item)
+src_data_acceptable(RtcomAvatar *avatar, TpAvatarRequirements *req)
 {
-  RtcomAvatar *avatar = RTCOM_AVATAR(widget);
-  RtcomAvatarPrivate *priv;
-  AccountService *service;
-  TpProtocol *protocol;
-  const char *mime = NULL;
-  const char *p;
-  const char *type;
-  GdkPixbuf *scaled = NULL;
-  GError *local_error = NULL;
-  gsize buffer_size;
-  gchar *buffer;
+  RtcomAvatarPrivate *priv = PRIVATE(avatar);
+  gint width = gdk_pixbuf_get_width(avatar->src);
+  gint height = gdk_pixbuf_get_height(avatar->src);
 
-  if (!avatar->src)
+  if (!priv->src_mime)
+    return FALSE;
+
+  /* large avatars of the account are scaled down like new ones */
+  if (priv->check_size && !priv->src_scaled &&
+      ((width > OSSO_ABOOK_PIXEL_SIZE_AVATAR_MEDIUM) ||
+       (height > OSSO_ABOOK_PIXEL_SIZE_AVATAR_MEDIUM)))
   {
-    tp_account_set_avatar_async(item->account, NULL, 0, NULL, NULL, NULL);
-    return TRUE;
+    return FALSE;
   }
 
-  priv = PRIVATE(avatar);
+  if (req)
+  {
+    if (!req->supported_mime_types ||
+        !tp_strv_contains((const gchar * const *)req->supported_mime_types,
+                          priv->src_mime))
+    {
+      return FALSE;
+    }
+
+    if ((req->maximum_bytes &&
+         g_bytes_get_size(priv->src_data) > req->maximum_bytes) ||
+        (req->maximum_width && width > (gint)req->maximum_width) ||
+        (req->maximum_height && height > (gint)req->maximum_height))
+    {
+      return FALSE;
+    }
+  }
+  else if (g_strcmp0(priv->src_mime, "image/png"))
+    return FALSE;
+
+  return TRUE;
+}
 
-  service = account_item_get_service(ACCOUNT_ITEM(item));
+static const gchar *
+get_avatar_mime(RtcomAccountItem *item, TpAvatarRequirements **req)
+{
+  AccountService *service = account_item_get_service(ACCOUNT_ITEM(item));
+  TpProtocol *protocol;
+  const gchar *mime = NULL;
+
+  *req = NULL;
   protocol = rtcom_account_service_get_protocol(RTCOM_ACCOUNT_SERVICE(service));
 
   if (protocol)
   {
-    TpAvatarRequirements *req = tp_protocol_get_avatar_requirements(protocol);
+    *req = tp_protocol_get_avatar_requirements(protocol);
 
-    if (req && req->supported_mime_types)
-      mime = req->supported_mime_types[0];
+    if (*req && (*req)->supported_mime_types)
+      mime = (*req)->supported_mime_types[0];
   }
 
   if (!protocol || !mime)
     mime = "image/png";
 
-  p = strrchr(mime, '/');
+  return mime;
+}
 
-  if (p)
-    type = p + 1;
-  else
-  {
-    g_warning("%s: Unexpected mime type: %s", __FUNCTION__, mime);
-    type = mime;
-  }
+static gboolean
+rtcom_avatar_store_settings(RtcomWidget *widget, GError **error,
+                            RtcomAccountItem *item)
+{
+  RtcomAvatar *avatar = RTCOM_AVATAR(widget);
+  RtcomAvatarPrivate *priv = PRIVATE(avatar);
+  TpAvatarRequirements *req;
+  const gchar *mime;
+  GError *local_error = NULL;
+  GBytes *bytes;
+
+  /* current avatar not fetched yet and not changed by the user */
+  if (priv->get_avatar_call || priv->decode_cancellable)
+    return TRUE;
 
-  if (priv->check_size)
+  if (!avatar->src)
   {
-    if ((gdk_pixbuf_get_width(avatar->src) >
-         OSSO_ABOOK_PIXEL_SIZE_AVATAR_MEDIUM) ||
-        (gdk_pixbuf_get_height(avatar->src) >
-         OSSO_ABOOK_PIXEL_SIZE_AVATAR_MEDIUM))
-    {
-      scaled = gdk_pixbuf_scale_simple(avatar->src,
-                                       OSSO_ABOOK_PIXEL_SIZE_AVATAR_MEDIUM,
-                                       OSSO_ABOOK_PIXEL_SIZE_AVATAR_MEDIUM,
-                                       GDK_INTERP_BILINEAR);
-    }
+    /* empty data clears the avatar, sent along with the other settings */
+    GBytes *empty = g_bytes_new(NULL, 0);
+
+    rtcom_account_item_store_avatar_bytes(item, empty, "");
+    g_bytes_unref(empty);
+
+    return TRUE;
   }
 
-  if (scaled)
+  mime = get_avatar_mime(item, &req);
+
+  /* the avatar of the account or the one encoded in the background is sent
+   * as is, if the protocol accepts it */
+  if (priv->src_data && src_data_acceptable(avatar, req))
   {
-    gdk_pixbuf_save_to_buffer(
-      scaled, &buffer, &buffer_size, type, &local_error, NULL);
-    g_object_unref(scaled);
+    rtcom_account_item_store_avatar_bytes(item, priv->src_data,
+                                          priv->src_mime);
+    return TRUE;
   }
-  else
+
+  /* background encoding did not finish in time */
+  cancel_task(&priv->encode_cancellable);
+  bytes = encode_avatar(avatar->src, priv->check_size, mime, &local_error);
+
+  if (bytes)
   {
-    gdk_pixbuf_save_to_buffer(
-      avatar->src, &buffer, &buffer_size, type, &local_error, NULL);
+    rtcom_account_item_store_avatar_bytes(item, bytes, mime);
+    g_bytes_unref(bytes);
   }
-
-  if (!local_error)
-    rtcom_account_item_store_avatar(item, buffer, buffer_size, mime);
   else
   {
     g_warning("%s, Failed to save avatar: %s", __FUNCTION__,
@@ -262,12 +504,45 @@ rtcom_avatar_store_settings(RtcomWidget *widget, GError **error,
   return TRUE;
 }
 
+static void
+avatar_decoded_cb(GObject *source_object, GAsyncResult *res,
+                  gpointer user_data)
+{
+  RtcomAvatar *avatar = user_data;
+  GError *error = NULL;
+  GdkPixbuf *pixbuf = rtcom_avatar_cache_get_pixbuf_finish(res, &error);
+
+  /* cancelled on dispose too, so @avatar must not be touched */
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+  {
+    g_error_free(error);
+    return;
+  }
+
+  g_clear_error(&error);
+  g_clear_object(&PRIVATE(avatar)->decode_cancellable);
+
+  if (pixbuf)
+  {
+    if (avatar->src)
+      g_object_unref(avatar->src);
+
+    avatar->src = pixbuf;
+    osso_abook_avatar_image_set_pixbuf(
+          OSSO_ABOOK_AVATAR_IMAGE(avatar->image), avatar->src);
+  }
+  else
+    clear_src_data(avatar);
+}
+
 static void
 _get_avatar_cb(TpProxy *proxy, const GValue *out_Value,
                const GError *error, gpointer user_data,
                GObject *weak_object)
 {
-  gpointer *data = user_data;
+  RtcomAvatar *avatar = RTCOM_AVATAR(weak_object);
+
+  PRIVATE(avatar)->get_avatar_call = NULL;
 
   if (error)
     g_warning("%s: Could not get avatar data %s", __FUNCTION__, error->message);
@@ -278,55 +553,49 @@ _get_avatar_cb(TpProxy *proxy, const GValue *out_Value,
   }
   else
   {
-    RtcomAvatar *avatar = RTCOM_AVATAR(data[1]);
     GValueArray *array = g_value_get_boxed(out_Value);
     const GArray *avatar_array;
     const gchar *mime_type;
-    GdkPixbufLoader *loader = gdk_pixbuf_loader_new();
 
     tp_value_array_unpack(array, 2, &avatar_array, &mime_type);
 
-    if (gdk_pixbuf_loader_write(loader, (guchar *)avatar_array->data,
-                                avatar_array->len, NULL))
+    if (avatar_array && avatar_array->len)
     {
-      avatar->src = gdk_pixbuf_loader_get_pixbuf(loader);
+      RtcomAvatarPrivate *priv = PRIVATE(avatar);
 
-      if (avatar->src)
-      {
-        g_object_ref(avatar->src);
-        osso_abook_avatar_image_set_pixbuf(
-              OSSO_ABOOK_AVATAR_IMAGE(avatar->image), avatar->src);
-      }
-    }
+      clear_src_data(avatar);
+      priv->src_data = g_bytes_new(avatar_array->data, avatar_array->len);
+      priv->src_mime = g_strdup(mime_type);
 
-    gdk_pixbuf_loader_close(loader, NULL);
-    g_object_unref(loader);
+      /* decoded in a worker thread, the default avatar is shown meanwhile */
+      priv->decode_cancellable = g_cancellable_new();
+      rtcom_avatar_cache_get_pixbuf_async(
+        priv->src_data, NULL, 0, 0, priv->decode_cancellable,
+        avatar_decoded_cb, avatar);
+    }
   }
-
-  g_main_loop_quit(data[0]);
 }
 
 static void
 rtcom_avatar_get_settings(RtcomWidget *widget, RtcomAccountItem *item)
 {
-  gpointer data[2];
+  RtcomAvatar *avatar = RTCOM_AVATAR(widget);
+  RtcomAvatarPrivate *priv = PRIVATE(avatar);
+  TpAvatarRequirements *req;
+
+  g_free(priv->encode_mime);
+  priv->encode_mime = g_strdup(get_avatar_mime(item, &req));
 
   if (!item->account)
     return;
 
-  data[0] = g_main_loop_new(NULL, FALSE);
-  data[1] = g_object_ref(widget);
-
-  tp_cli_dbus_properties_call_get(
-    item->account, -1, TP_IFACE_ACCOUNT_INTERFACE_AVATAR, "Avatar",
-    _get_avatar_cb, data, NULL, NULL);
-
-  GDK_THREADS_LEAVE();
-  g_main_loop_run(data[0]);
-  GDK_THREADS_ENTER();
+  cancel_get_avatar(avatar);
 
-  g_main_loop_unref(data[0]);
-  g_object_unref(data[1]);
+  /* the default avatar is shown until the reply arrives, the call is
+   * cancelled if the widget goes away first */
+  PRIVATE(avatar)->get_avatar_call = tp_cli_dbus_properties_call_get(
+      item->account, -1, TP_IFACE_ACCOUNT_INTERFACE_AVATAR, "Avatar",
+      _get_avatar_cb, NULL, NULL, G_OBJECT(widget));
 }
 
 static void
@@ -39,6 +39,84 @@ enum
   PROP_MAX_LENGTH_MSG
 };
 
+typedef struct
+{
+  gchar *key;
+  GRegex *regex;
+  guint refcount;
+}
+RegexCacheEntry;
+
+/* "<flags>:<pattern>" -> RegexCacheEntry, shared by all validators, so
+ * widgets using the same pattern don't compile it again. Main thread only. */
+static GHashTable *regex_cache = NULL;
+/* GRegex -> RegexCacheEntry */
+static GHashTable *regex_cache_entries = NULL;
+
+static GRegex *
+regex_cache_acquire(const gchar *pattern, GRegexCompileFlags flags,
+                    GError **error)
+{
+  gchar *key = g_strdup_printf("%x:%s", flags, pattern);
+  RegexCacheEntry *entry;
+  GRegex *regex;
+
+  if (!regex_cache)
+  {
+    regex_cache = g_hash_table_new((GHashFunc)&g_str_hash,
+                                   (GEqualFunc)&g_str_equal);
+    regex_cache_entries = g_hash_table_new(NULL, NULL);
+  }
+
+  entry = g_hash_table_lookup(regex_cache, key);
+
+  if (entry)
+  {
+    g_free(key);
+    entry->refcount++;
+
+    return entry->regex;
+  }
+
+  /* matched on every keystroke, so it is worth optimizing */
+  regex = g_regex_new(pattern, flags | G_REGEX_OPTIMIZE, 0, error);
+
+  if (!regex)
+  {
+    g_free(key);
+    return NULL;
+  }
+
+  entry = g_slice_new(RegexCacheEntry);
+  entry->key = key;
+  entry->regex = regex;
+  entry->refcount = 1;
+  g_hash_table_insert(regex_cache, entry->key, entry);
+  g_hash_table_insert(regex_cache_entries, entry->regex, entry);
+
+  return regex;
+}
+
+static void
+regex_cache_release(GRegex *regex)
+{
+  RegexCacheEntry *entry = NULL;
+
+  if (regex_cache_entries)
+    entry = g_hash_table_lookup(regex_cache_entries, regex);
+
+  g_return_if_fail(entry != NULL);
+
+  if (--entry->refcount)
+    return;
+
+  g_hash_table_remove(regex_cache_entries, entry->regex);
+  g_hash_table_remove(regex_cache, entry->key);
+  g_regex_unref(entry->regex);
+  g_free(entry->key);
+  g_slice_free(RegexCacheEntry, entry);
+}
+
 static void
 rtcom_entry_validation_set_property(GObject *object, guint property_id,
                                     const GValue *value, GParamSpec *pspec)
@@ -138,7 +216,7 @@ rtcom_entry_validation_dispose(GObject *object)
 
   if (validation->validation_re)
   {
-    g_regex_unref(validation->validation_re);
+    regex_cache_release(validation->validation_re);
     validation->validation_re = NULL;
   }
 
@@ -233,15 +311,17 @@ rtcom_entry_validation_set_invalid_chars_re(RtcomEntryValidation *self,
                                             const gchar *pattern)
 {
   GError *error = NULL;
+  GRegex *regex;
 
   g_return_if_fail(pattern);
 
-  self->validation_re = self->validation_re;
+  /* acquire first, so setting the same pattern again doesn't recompile it */
+  regex = regex_cache_acquire(pattern, 0, &error);
 
   if (self->validation_re)
-    g_regex_unref(self->validation_re);
+    regex_cache_release(self->validation_re);
 
-  self->validation_re = g_regex_new(pattern, 0, 0, &error);
+  self->validation_re = regex;
 
   if (!self->validation_re)
   {
@@ -23,12 +23,23 @@
 
 #include "rtcom-page.h"
 
-G_DEFINE_TYPE(
+struct _RtcomPagePrivate
+{
+  /* number of widgets not allowing next */
+  guint blocked;
+};
+
+typedef struct _RtcomPagePrivate RtcomPagePrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE(
   RtcomPage,
   rtcom_page,
   GTK_TYPE_BIN
 )
 
+#define PRIVATE(page) \
+  ((RtcomPagePrivate *)rtcom_page_get_instance_private((RtcomPage *)(page)))
+
 enum
 {
   PROP_VALID = 1,
@@ -172,17 +183,22 @@ _rtcom_page_validate(RtcomPage *page, GError **error)
   return TRUE;
 }
 
-static gboolean
-widget_has_not_flag(gpointer key, gpointer value, gpointer user_data)
+static void
+set_widget_flags(RtcomPage *page, gpointer widget, gint flags)
 {
-  return !(GPOINTER_TO_INT(user_data) & GPOINTER_TO_INT(value));
-}
+  RtcomPagePrivate *priv = PRIVATE(page);
+  gpointer old_flags;
 
-static gboolean
-widgets_have_flag(RtcomPage *page, gint flag)
-{
-  return !g_hash_table_find(page->widgets, widget_has_not_flag,
-                            GINT_TO_POINTER(flag));
+  if (g_hash_table_lookup_extended(page->widgets, widget, NULL, &old_flags) &&
+      !(GPOINTER_TO_INT(old_flags) & FLAG_CAN_NEXT))
+  {
+    priv->blocked--;
+  }
+
+  if (!(flags & FLAG_CAN_NEXT))
+    priv->blocked++;
+
+  g_hash_table_replace(page->widgets, widget, GINT_TO_POINTER(flags));
 }
 
 static void
@@ -199,7 +215,7 @@ widget_can_next_changed(GtkWidget *widget, GParamSpec *pspec, RtcomPage *page)
   else
     new_flags = old_flags & ~global_flags;
 
-  g_hash_table_replace(page->widgets, widget, GINT_TO_POINTER(new_flags));
+  set_widget_flags(page, widget, new_flags);
 
   if (global_flags & page->flags)
   {
@@ -209,7 +225,7 @@ widget_can_next_changed(GtkWidget *widget, GParamSpec *pspec, RtcomPage *page)
       g_object_notify(G_OBJECT(page), "can-next");
     }
   }
-  else if (can_next && widgets_have_flag(page, global_flags))
+  else if (can_next && !PRIVATE(page)->blocked)
   {
     page->flags |= global_flags;
     g_object_notify(G_OBJECT(page), "can-next");
@@ -240,9 +256,8 @@ rtcom_page_set_account_intern(GtkWidget *widget, gpointer user_data)
       }
     }
 
-    g_hash_table_insert(
-      page->widgets, widget,
-      GINT_TO_POINTER(0x8000 | (can_next ? PROP_CAN_NEXT : 0)));
+    set_widget_flags(page, widget,
+                     0x8000 | (can_next ? FLAG_CAN_NEXT : 0));
     g_signal_connect_swapped(page, "validate",
                              G_CALLBACK(rtcom_widget_validate), widget);
   }
@@ -418,7 +433,7 @@ rtcom_page_set_object_can_next(RtcomPage *page, GObject *object,
   if (can_next)
     flags |= FLAG_CAN_NEXT;
 
-  g_hash_table_replace(page->widgets, object, GINT_TO_POINTER(flags));
+  set_widget_flags(page, object, flags);
 
   if (page->flags & FLAG_CAN_NEXT)
   {
@@ -428,7 +443,7 @@ rtcom_page_set_object_can_next(RtcomPage *page, GObject *object,
       g_object_notify(G_OBJECT(page), "can-next");
     }
   }
-  else if (can_next && widgets_have_flag(page, FLAG_CAN_NEXT))
+  else if (can_next && !PRIVATE(page)->blocked)
   {
     page->flags |= FLAG_CAN_NEXT;
     g_object_notify(G_OBJECT(page), "can-next");
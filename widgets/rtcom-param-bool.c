@@ -175,20 +175,22 @@ static void
 rtcom_param_bool_set_account(RtcomWidget *widget, RtcomAccountItem *account)
 {
   RtcomParamBool *self = RTCOM_PARAM_BOOL(widget);
-  TpProtocol *protocol = rtcom_account_item_get_tp_protocol(account);
+  AccountService *service = account_item_get_service(ACCOUNT_ITEM(account));
 
   if (self->field)
   {
-    const TpConnectionManagerParam *param;
-    GValue v = G_VALUE_INIT;
+    const RtcomParamSchema *schema;
 
-    param = tp_protocol_get_param(protocol, self->field);
+    schema = rtcom_account_service_get_param_schema(
+        RTCOM_ACCOUNT_SERVICE(service), self->field);
 
-    if (param && tp_connection_manager_param_get_default(param, &v))
+    if (schema && G_IS_VALUE(&schema->default_value))
     {
-      if (G_VALUE_HOLDS_STRING(&v))
+      const GValue *v = &schema->default_value;
+
+      if (G_VALUE_HOLDS_STRING(v))
       {
-        const gchar *s = g_value_get_string(&v);
+        const gchar *s = g_value_get_string(v);
 
         if (s && *s)
         {
@@ -203,13 +205,11 @@ rtcom_param_bool_set_account(RtcomWidget *widget, RtcomAccountItem *account)
           }
         }
       }
-      else if (G_VALUE_HOLDS_BOOLEAN(&v))
+      else if (G_VALUE_HOLDS_BOOLEAN(v))
         hildon_check_button_set_active(HILDON_CHECK_BUTTON(self),
-                                       g_value_get_boolean(&v));
+                                       g_value_get_boolean(v));
     }
   }
-
-  g_object_unref(protocol);
 }
 
 static void
@@ -246,34 +246,29 @@ static void
 rtcom_param_int_account(RtcomWidget *widget, RtcomAccountItem *account)
 {
   RtcomParamInt *self = RTCOM_PARAM_INT(widget);
-  TpProtocol *protocol = rtcom_account_item_get_tp_protocol(account);
+  AccountService *service = account_item_get_service(ACCOUNT_ITEM(account));
+  const RtcomParamSchema *schema;
 
-  if (protocol)
-  {
-    const TpConnectionManagerParam *param;
-    GValue v = G_VALUE_INIT;
-
-    param = tp_protocol_get_param(protocol, self->field);
-
-    if (param && tp_connection_manager_param_get_default(param, &v))
-    {
-      gchar *text = NULL;
-
-      if (G_VALUE_HOLDS_STRING(&v))
-        text = g_strdup(g_value_get_string(&v));
-      else if (G_VALUE_HOLDS_INT(&v))
-        text = g_strdup_printf("%d", g_value_get_int(&v));
-      else if (G_VALUE_HOLDS_UINT(&v))
-        text = g_strdup_printf("%u", g_value_get_uint(&v));
-      else
-        g_warn_if_reached();
+  schema = rtcom_account_service_get_param_schema(
+      RTCOM_ACCOUNT_SERVICE(service), self->field);
 
-      hildon_entry_set_text(HILDON_ENTRY(self), text);
+  if (schema && G_IS_VALUE(&schema->default_value))
+  {
+    const GValue *v = &schema->default_value;
+    gchar *text = NULL;
+
+    if (G_VALUE_HOLDS_STRING(v))
+      text = g_strdup(g_value_get_string(v));
+    else if (G_VALUE_HOLDS_INT(v))
+      text = g_strdup_printf("%d", g_value_get_int(v));
+    else if (G_VALUE_HOLDS_UINT(v))
+      text = g_strdup_printf("%u", g_value_get_uint(v));
+    else
+      g_warn_if_reached();
 
-      g_free(text);
-    }
+    hildon_entry_set_text(HILDON_ENTRY(self), text);
 
-    g_object_unref(protocol);
+    g_free(text);
   }
 }
 
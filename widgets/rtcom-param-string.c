@@ -24,7 +24,18 @@
 
 #include "rtcom-param-string.h"
 
-RTCOM_DEFINE_WIDGET_TYPE(
+struct _RtcomParamStringPrivate
+{
+  guint scroll_id;
+};
+
+typedef struct _RtcomParamStringPrivate RtcomParamStringPrivate;
+
+#define PRIVATE(string) \
+  ((RtcomParamStringPrivate *) \
+   rtcom_param_string_get_instance_private((RtcomParamString *)(string)))
+
+RTCOM_DEFINE_WIDGET_TYPE_WITH_PRIVATE(
   RtcomParamString,
   rtcom_param_string,
   HILDON_TYPE_ENTRY
@@ -82,27 +93,20 @@ static void
 rtcom_param_string_set_account(RtcomWidget *widget, RtcomAccountItem *account)
 {
   RtcomParamString *string = RTCOM_PARAM_STRING(widget);
-  TpProtocol *protocol = rtcom_account_item_get_tp_protocol(account);
+  AccountService *service = account_item_get_service(ACCOUNT_ITEM(account));
+  const RtcomParamSchema *schema;
 
-  if (!protocol)
+  if (!string->field)
     return;
 
-  if (string->field)
-  {
-    const TpConnectionManagerParam *param;
-    GValue v = G_VALUE_INIT;
-
-    param = tp_protocol_get_param(protocol, string->field);
+  schema = rtcom_account_service_get_param_schema(
+      RTCOM_ACCOUNT_SERVICE(service), string->field);
 
-    if (param &&
-        tp_connection_manager_param_get_default(param, &v) &&
-        G_VALUE_HOLDS_STRING(&v))
-    {
-      gtk_entry_set_text(GTK_ENTRY(string), g_value_get_string(&v));
-    }
+  if (schema && G_VALUE_HOLDS_STRING(&schema->default_value))
+  {
+    gtk_entry_set_text(GTK_ENTRY(string),
+                       g_value_get_string(&schema->default_value));
   }
-
-  g_object_unref(protocol);
 }
 
 static void
@@ -138,6 +142,13 @@ static void
 rtcom_param_string_dispose(GObject *object)
 {
   RtcomParamString *string = RTCOM_PARAM_STRING(object);
+  RtcomParamStringPrivate *priv = PRIVATE(string);
+
+  if (priv->scroll_id)
+  {
+    g_source_remove(priv->scroll_id);
+    priv->scroll_id = 0;
+  }
 
   if (string->validation)
   {
@@ -379,12 +390,13 @@ rtcom_param_string_class_init(RtcomParamStringClass *klass)
       GTK_PARAM_WRITABLE));
 }
 
-static void
-_changed(RtcomParamString *string)
+static gboolean
+scroll_to_entry_idle(gpointer user_data)
 {
+  RtcomParamString *string = user_data;
   GtkWidget *area;
-  const gchar *text;
 
+  PRIVATE(string)->scroll_id = 0;
   area = gtk_widget_get_ancestor(GTK_WIDGET(string),
                                  HILDON_TYPE_PANNABLE_AREA);
 
@@ -394,6 +406,22 @@ _changed(RtcomParamString *string)
                                        GTK_WIDGET(string));
   }
 
+  return G_SOURCE_REMOVE;
+}
+
+static void
+_changed(RtcomParamString *string)
+{
+  RtcomParamStringPrivate *priv = PRIVATE(string);
+  const gchar *text;
+
+  /* keep the entry visible, once per frame rather than on every key */
+  if (!priv->scroll_id)
+  {
+    priv->scroll_id = g_idle_add_full(G_PRIORITY_HIGH_IDLE,
+                                      scroll_to_entry_idle, string, NULL);
+  }
+
   text = gtk_entry_get_text(&string->parent_instance.parent);
 
   if (text && *text)
@@ -0,0 +1,273 @@
+/*
+ * rtcom-protocol-cache.c
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+#include <telepathy-glib/dbus.h>
+#include <telepathy-glib/util.h>
+
+#include <errno.h>
+
+#include "rtcom-protocol-cache.h"
+
+#define CACHE_VERSION 1
+#define CACHE_GROUP "cache"
+#define PROTOCOL_GROUP_PREFIX "protocol "
+
+/* CM name -> GKeyFile, NULL if there is no valid cache for that CM */
+static GHashTable *cache = NULL;
+
+static gchar *
+get_cache_path(const gchar *cm_name)
+{
+  return g_build_filename(g_get_user_cache_dir(), "rtcom-accounts-ui",
+                          "protocols", cm_name, NULL);
+}
+
+/* Returns the path of the .manager file telepathy-glib would use for
+ * @cm_name, NULL if the CM is not described by one */
+static gchar *
+find_manager_file(const gchar *cm_name, gint64 *mtime)
+{
+  const gchar * const *dirs = g_get_system_data_dirs();
+  gchar *file_name = g_strconcat(cm_name, ".manager", NULL);
+  gchar *path;
+  struct stat st;
+
+  path = g_build_filename(g_get_user_data_dir(), "telepathy", "managers",
+                          file_name, NULL);
+
+  while (g_stat(path, &st))
+  {
+    g_free(path);
+    path = NULL;
+
+    if (!*dirs)
+      break;
+
+    path = g_build_filename(*dirs++, "telepathy", "managers", file_name,
+                            NULL);
+  }
+
+  g_free(file_name);
+
+  if (path)
+    *mtime = st.st_mtime;
+
+  return path;
+}
+
+static GKeyFile *
+load_cm_cache(const gchar *cm_name)
+{
+  GKeyFile *key_file = g_key_file_new();
+  gchar *path = get_cache_path(cm_name);
+  gchar *manager_file = NULL;
+  gchar *cached_manager_file = NULL;
+  gint64 mtime;
+
+  if (!g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, NULL) ||
+      (g_key_file_get_integer(key_file, CACHE_GROUP, "version", NULL) !=
+       CACHE_VERSION))
+  {
+    goto err;
+  }
+
+  manager_file = find_manager_file(cm_name, &mtime);
+
+  if (!manager_file)
+    goto err;
+
+  cached_manager_file = g_key_file_get_string(key_file, CACHE_GROUP,
+                                              "manager-file", NULL);
+
+  if (g_strcmp0(manager_file, cached_manager_file) ||
+      (g_key_file_get_int64(key_file, CACHE_GROUP, "manager-mtime", NULL) !=
+       mtime))
+  {
+    goto err;
+  }
+
+  g_free(cached_manager_file);
+  g_free(manager_file);
+  g_free(path);
+
+  return key_file;
+
+err:
+  g_free(cached_manager_file);
+  g_free(manager_file);
+  g_free(path);
+  g_key_file_free(key_file);
+
+  return NULL;
+}
+
+static void
+key_file_free(GKeyFile *key_file)
+{
+  if (key_file)
+    g_key_file_free(key_file);
+}
+
+static GKeyFile *
+get_cm_cache(const gchar *cm_name)
+{
+  GKeyFile *key_file;
+
+  if (!cache)
+  {
+    cache = g_hash_table_new_full((GHashFunc)&g_str_hash,
+                                  (GEqualFunc)&g_str_equal,
+                                  (GDestroyNotify)&g_free,
+                                  (GDestroyNotify)&key_file_free);
+  }
+
+  if (g_hash_table_lookup_extended(cache, cm_name, NULL,
+                                   (gpointer *)&key_file))
+  {
+    return key_file;
+  }
+
+  key_file = load_cm_cache(cm_name);
+
+  g_hash_table_insert(cache, g_strdup(cm_name), key_file);
+
+  return key_file;
+}
+
+TpProtocol *
+rtcom_protocol_cache_lookup(const gchar *cm_name, const gchar *protocol_name)
+{
+  GKeyFile *key_file = get_cm_cache(cm_name);
+  TpProtocol *protocol = NULL;
+  GVariant *variant = NULL;
+  TpDBusDaemon *dbus_daemon;
+  GHashTable *properties;
+  GError *error = NULL;
+  gchar *group;
+  gchar *data;
+
+  if (!key_file)
+    return NULL;
+
+  group = g_strconcat(PROTOCOL_GROUP_PREFIX, protocol_name, NULL);
+  data = g_key_file_get_string(key_file, group, "properties", NULL);
+  g_free(group);
+
+  if (data)
+  {
+    variant = g_variant_parse(G_VARIANT_TYPE_VARDICT, data, NULL, NULL,
+                              &error);
+    g_free(data);
+  }
+
+  if (!variant)
+    goto out;
+
+  dbus_daemon = tp_dbus_daemon_dup(&error);
+
+  if (dbus_daemon)
+  {
+    properties = tp_asv_from_vardict(variant);
+    protocol = tp_protocol_new(dbus_daemon, cm_name, protocol_name,
+                               properties, &error);
+    g_hash_table_unref(properties);
+    g_object_unref(dbus_daemon);
+  }
+
+  g_variant_unref(variant);
+
+out:
+  if (error)
+  {
+    g_warning("%s: Invalid cache entry for %s/%s: %s", __FUNCTION__, cm_name,
+              protocol_name, error->message);
+    g_error_free(error);
+  }
+
+  return protocol;
+}
+
+void
+rtcom_protocol_cache_store(TpConnectionManager *cm)
+{
+  const gchar *cm_name = tp_connection_manager_get_name(cm);
+  GKeyFile *key_file;
+  gchar *manager_file;
+  gchar *path;
+  gchar *dir;
+  GError *error = NULL;
+  GList *protocols;
+  GList *l;
+  gchar *data;
+  gsize len;
+  gint64 mtime;
+
+  /* CMs without a .manager file are always introspected */
+  manager_file = find_manager_file(cm_name, &mtime);
+
+  if (!manager_file)
+    return;
+
+  key_file = g_key_file_new();
+  g_key_file_set_integer(key_file, CACHE_GROUP, "version", CACHE_VERSION);
+  g_key_file_set_string(key_file, CACHE_GROUP, "manager-file", manager_file);
+  g_key_file_set_int64(key_file, CACHE_GROUP, "manager-mtime", mtime);
+
+  protocols = tp_connection_manager_dup_protocols(cm);
+
+  for (l = protocols; l; l = l->next)
+  {
+    TpProtocol *protocol = l->data;
+    GVariant *properties = tp_protocol_dup_immutable_properties(protocol);
+    gchar *group = g_strconcat(PROTOCOL_GROUP_PREFIX,
+                               tp_protocol_get_name(protocol), NULL);
+
+    data = g_variant_print(properties, TRUE);
+    g_key_file_set_string(key_file, group, "properties", data);
+    g_free(data);
+    g_free(group);
+    g_variant_unref(properties);
+  }
+
+  g_list_free_full(protocols, g_object_unref);
+
+  path = get_cache_path(cm_name);
+  dir = g_path_get_dirname(path);
+  data = g_key_file_to_data(key_file, &len, NULL);
+
+  if (g_mkdir_with_parents(dir, 0700) ||
+      !g_file_set_contents(path, data, len, &error))
+  {
+    g_warning("%s: Unable to save protocols cache to %s: %s",
+              __FUNCTION__, path, error ? error->message : g_strerror(errno));
+    g_clear_error(&error);
+  }
+
+  if (cache)
+    g_hash_table_remove(cache, cm_name);
+
+  g_free(data);
+  g_free(dir);
+  g_free(path);
+  g_free(manager_file);
+  g_key_file_free(key_file);
+}
@@ -0,0 +1,40 @@
+/*
+ * rtcom-protocol-cache.h
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _RTCOM_PROTOCOL_CACHE_H_
+#define _RTCOM_PROTOCOL_CACHE_H_
+
+#include <telepathy-glib/connection-manager.h>
+#include <telepathy-glib/protocol.h>
+
+G_BEGIN_DECLS
+
+/* Returns a new TpProtocol built from the cached immutable properties of
+ * @protocol_name on @cm_name, or NULL if there is no cache entry or it is
+ * older than the CM's .manager file. */
+TpProtocol *
+rtcom_protocol_cache_lookup(const gchar *cm_name, const gchar *protocol_name);
+
+/* Saves the protocols of the prepared @cm */
+void
+rtcom_protocol_cache_store(TpConnectionManager *cm);
+
+G_END_DECLS
+
+#endif /* _RTCOM_PROTOCOL_CACHE_H_ */
@@ -0,0 +1,194 @@
+/*
+ * rtcom-trace.c
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "rtcom-trace.h"
+
+#define TRACE_ENV "RTCOM_ACCOUNTS_TRACE"
+/* registered by the first copy of this file in the process that opens the
+ * trace, quarks are shared by all the copies */
+#define TRACE_OPENED_QUARK "rtcom-accounts-trace-opened"
+
+G_LOCK_DEFINE_STATIC(trace);
+
+static int trace_fd = -1;
+static gsize trace_initialized = 0;
+
+static gchar *
+get_trace_path(const gchar *path)
+{
+  GString *s = g_string_new(NULL);
+
+  for (; *path; path++)
+  {
+    if (path[0] == '%' && path[1] == 'p')
+    {
+      g_string_append_printf(s, "%d", (int)getpid());
+      path++;
+    }
+    else
+      g_string_append_c(s, *path);
+  }
+
+  return g_string_free(s, FALSE);
+}
+
+static void
+trace_open(void)
+{
+  const gchar *env = g_getenv(TRACE_ENV);
+  gboolean first;
+  gchar *path;
+
+  if (!env || !*env)
+    return;
+
+  /* every library and program that records spans has its own copy of this
+   * file. The first one creates the file, the others append to it */
+  first = !g_quark_try_string(TRACE_OPENED_QUARK);
+  path = get_trace_path(env);
+  trace_fd = g_open(path, O_WRONLY | O_CREAT | O_APPEND | (first ? O_TRUNC : 0),
+                    0644);
+
+  if (trace_fd != -1)
+  {
+    g_quark_from_string(TRACE_OPENED_QUARK);
+
+    if (first && write(trace_fd, "[\n", 2) != 2)
+      g_warning("Unable to write trace file %s: %s", path, g_strerror(errno));
+  }
+  else
+    g_warning("Unable to open trace file %s: %s", path, g_strerror(errno));
+
+  g_free(path);
+}
+
+gboolean
+rtcom_trace_is_enabled(void)
+{
+  if (g_once_init_enter(&trace_initialized))
+  {
+    trace_open();
+    g_once_init_leave(&trace_initialized, 1);
+  }
+
+  return trace_fd != -1;
+}
+
+static void
+append_json_string(GString *s, const gchar *str)
+{
+  g_string_append_c(s, '"');
+
+  for (; *str; str++)
+  {
+    guchar c = *str;
+
+    if (c == '"' || c == '\\')
+    {
+      g_string_append_c(s, '\\');
+      g_string_append_c(s, c);
+    }
+    else if (c < 0x20)
+      g_string_append_printf(s, "\\u%04x", c);
+    else
+      g_string_append_c(s, c);
+  }
+
+  g_string_append_c(s, '"');
+}
+
+static void
+write_event(const gchar *name, const gchar *detail, char phase, gint64 ts,
+            gint64 dur)
+{
+  GString *s = g_string_sized_new(160);
+
+  g_string_append(s, "{\"name\":");
+  append_json_string(s, name);
+  g_string_append_printf(
+    s, ",\"cat\":\"rtcom-accounts\",\"ph\":\"%c\",\"ts\":%" G_GINT64_FORMAT
+    ",\"pid\":%d,\"tid\":%ld", phase, ts, (int)getpid(),
+    (long)syscall(SYS_gettid));
+
+  if (phase == 'X')
+    g_string_append_printf(s, ",\"dur\":%" G_GINT64_FORMAT, dur);
+  else
+    g_string_append(s, ",\"s\":\"t\"");
+
+  if (detail)
+  {
+    g_string_append(s, ",\"args\":{\"detail\":");
+    append_json_string(s, detail);
+    g_string_append_c(s, '}');
+  }
+
+  /* the closing ] is optional in the trace event format, and viewers accept
+   * the comma after the last event */
+  g_string_append(s, "},\n");
+
+  /* a single append per event, so events of the other copies don't end up
+   * in the middle of it */
+  G_LOCK(trace);
+
+  if (write(trace_fd, s->str, s->len) != (ssize_t)s->len)
+    g_warning("%s: Unable to write trace event %s", __FUNCTION__, name);
+
+  G_UNLOCK(trace);
+
+  g_string_free(s, TRUE);
+}
+
+gint64
+rtcom_trace_begin(void)
+{
+  if (!rtcom_trace_is_enabled())
+    return 0;
+
+  return g_get_monotonic_time();
+}
+
+void
+rtcom_trace_end(gint64 begin, const gchar *name, const gchar *detail)
+{
+  g_return_if_fail(name != NULL);
+
+  /* span started before tracing was enabled */
+  if (!begin || !rtcom_trace_is_enabled())
+    return;
+
+  write_event(name, detail, 'X', begin, g_get_monotonic_time() - begin);
+}
+
+void
+rtcom_trace_mark(const gchar *name, const gchar *detail)
+{
+  g_return_if_fail(name != NULL);
+
+  if (rtcom_trace_is_enabled())
+    write_event(name, detail, 'i', g_get_monotonic_time(), 0);
+}
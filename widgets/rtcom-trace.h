@@ -0,0 +1,51 @@
+/*
+ * rtcom-trace.h
+ *
+ * Copyright (C) 2022 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _RTCOM_TRACE_H_
+#define _RTCOM_TRACE_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Timing spans, written in Chrome trace event format to the file named by
+ * RTCOM_ACCOUNTS_TRACE ("%p" is replaced by the process id). When the
+ * variable is not set all the calls below are no-ops.
+ *
+ * Not installed: every library and program links its own hidden copy from
+ * librtcom-trace.la, and all the copies of a process share the file. */
+
+G_GNUC_INTERNAL gboolean
+rtcom_trace_is_enabled(void);
+
+/* Returns the start time of a span, 0 if tracing is disabled */
+G_GNUC_INTERNAL gint64
+rtcom_trace_begin(void);
+
+/* Records the span @name that started at @begin. @detail may be NULL */
+G_GNUC_INTERNAL void
+rtcom_trace_end(gint64 begin, const gchar *name, const gchar *detail);
+
+/* Records the instant event @name. @detail may be NULL */
+G_GNUC_INTERNAL void
+rtcom_trace_mark(const gchar *name, const gchar *detail);
+
+G_END_DECLS
+
+#endif /* _RTCOM_TRACE_H_ */
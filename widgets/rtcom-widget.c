@@ -32,6 +32,7 @@ struct _RtcomWidgetPrivate
   RtcomAccountItem *account;
   gchar *msg_next;
   GtkWidget *error_widget;
+  guint value_changed_id;
 };
 
 typedef struct _RtcomWidgetPrivate RtcomWidgetPrivate;
@@ -97,7 +98,15 @@ rtcom_widget_set_property(GObject *object, guint property_id,
     }
     case PROP_CAN_NEXT:
     {
-      priv->can_next = g_value_get_boolean(value);
+      gboolean can_next = g_value_get_boolean(value);
+
+      /* set on every keystroke, so notify the page on changes only */
+      if (priv->can_next != can_next)
+      {
+        priv->can_next = can_next;
+        g_object_notify(object, "can-next");
+      }
+
       break;
     }
     case PROP_NAME_CHANGE:
@@ -207,7 +216,7 @@ rtcom_widget_class_init(GObjectClass *object_class)
       "Can next",
       "Allow page `Next' button",
       TRUE,
-      G_PARAM_READWRITE));
+      G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY));
   g_object_class_install_property(
     object_class, PROP_NAME_CHANGE,
     g_param_spec_boolean(
@@ -222,6 +231,9 @@ rtcom_widget_private_free(gpointer data)
 {
   RtcomWidgetPrivate *priv = data;
 
+  if (priv->value_changed_id)
+    g_source_remove(priv->value_changed_id);
+
   g_free(priv->msg_next);
   g_free(priv);
 }
@@ -393,6 +405,19 @@ rtcom_widget_get_value(RtcomWidget *widget, GValue *value)
   return FALSE;
 }
 
+static gboolean
+value_changed_idle(gpointer user_data)
+{
+  RtcomWidgetPrivate *priv = g_object_get_data(user_data, "rtcom");
+
+  priv->value_changed_id = 0;
+
+  if (priv->account && priv->name_change)
+    rtcom_account_item_name_change(priv->account);
+
+  return G_SOURCE_REMOVE;
+}
+
 void
 rtcom_widget_value_changed(RtcomWidget *widget)
 {
@@ -402,6 +427,10 @@ rtcom_widget_value_changed(RtcomWidget *widget)
 
   priv = g_object_get_data(G_OBJECT(widget), "rtcom");
 
-  if ( priv->account && priv->name_change)
-    rtcom_account_item_name_change(priv->account);
+  /* called on every keystroke, emit "name-changed" once per frame */
+  if (priv->account && priv->name_change && !priv->value_changed_id)
+  {
+    priv->value_changed_id =
+      g_idle_add_full(G_PRIORITY_HIGH_IDLE, value_changed_idle, widget, NULL);
+  }
 }